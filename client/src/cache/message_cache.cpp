@@ -0,0 +1,195 @@
+#include "message_cache.h"
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+
+// ─── Schema ───────────────────────────────────────────────────────────────────
+
+static const char* SCHEMA = R"sql(
+PRAGMA journal_mode=WAL;
+PRAGMA synchronous=NORMAL;
+
+CREATE TABLE IF NOT EXISTS messages (
+    id         INTEGER PRIMARY KEY,
+    channel_id INTEGER NOT NULL,
+    author_id  INTEGER NOT NULL,
+    author     TEXT    NOT NULL,
+    content    TEXT    NOT NULL,
+    ts         INTEGER NOT NULL
+);
+
+CREATE INDEX IF NOT EXISTS idx_messages_channel ON messages(channel_id, id);
+)sql";
+
+// ─── Helpers ──────────────────────────────────────────────────────────────────
+
+bool MessageCache::exec(const char* sql) {
+    char* errmsg = nullptr;
+    if (sqlite3_exec(db_, sql, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        fprintf(stderr, "[cache] exec error: %s\n", errmsg ? errmsg : "?");
+        sqlite3_free(errmsg);
+        return false;
+    }
+    return true;
+}
+
+sqlite3_stmt* MessageCache::prepare(const char* sql) {
+    if (!db_) return nullptr;
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db_, sql, -1, &st, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "[cache] prepare error: %s  sql=%s\n", sqlite3_errmsg(db_), sql);
+        return nullptr;
+    }
+    return st;
+}
+
+static std::string column_text(sqlite3_stmt* st, int col) {
+    const unsigned char* t = sqlite3_column_text(st, col);
+    return t ? (const char*)t : "";
+}
+
+std::string message_cache_file(const std::string& host, int port, int user_id) {
+    std::string safe = host;
+    for (char& c : safe)
+        if (!isalnum((unsigned char)c) && c != '.' && c != '-') c = '_';
+    return "cache-" + safe + "-" + std::to_string(port) +
+           "-u" + std::to_string(user_id) + ".db";
+}
+
+// ─── MessageCache ─────────────────────────────────────────────────────────────
+
+MessageCache::~MessageCache() { close(); }
+
+bool MessageCache::open(const std::string& path) {
+    close();
+    if (sqlite3_open(path.c_str(), &db_) != SQLITE_OK) {
+        fprintf(stderr, "[cache] cannot open %s: %s\n", path.c_str(),
+                db_ ? sqlite3_errmsg(db_) : "out of memory");
+        close();
+        return false;
+    }
+    if (!exec(SCHEMA)) { close(); return false; }
+    return true;
+}
+
+void MessageCache::close() {
+    if (db_) sqlite3_close(db_);
+    db_ = nullptr;
+}
+
+std::vector<MessageInfo> MessageCache::load(int channel_id, int limit, int before_id) {
+    std::vector<MessageInfo> msgs;
+    sqlite3_stmt* st = prepare(
+        "SELECT id,channel_id,author_id,author,content,ts FROM messages "
+        "WHERE channel_id=? AND id<? ORDER BY id DESC LIMIT ?");
+    if (!st) return msgs;
+
+    sqlite3_bind_int(st, 1, channel_id);
+    sqlite3_bind_int64(st, 2, before_id > 0 ? before_id : INT64_MAX);
+    sqlite3_bind_int(st, 3, limit);
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        MessageInfo m;
+        m.id         = sqlite3_column_int(st, 0);
+        m.channel_id = sqlite3_column_int(st, 1);
+        m.author_id  = sqlite3_column_int(st, 2);
+        m.author     = column_text(st, 3);
+        m.content    = column_text(st, 4);
+        m.ts         = sqlite3_column_int64(st, 5);
+        msgs.push_back(std::move(m));
+    }
+    sqlite3_finalize(st);
+
+    std::reverse(msgs.begin(), msgs.end());
+    return msgs;
+}
+
+int MessageCache::newest_id(int channel_id) {
+    sqlite3_stmt* st = prepare("SELECT MAX(id) FROM messages WHERE channel_id=?");
+    if (!st) return 0;
+    sqlite3_bind_int(st, 1, channel_id);
+    int id = 0;
+    if (sqlite3_step(st) == SQLITE_ROW) id = sqlite3_column_int(st, 0);
+    sqlite3_finalize(st);
+    return id;
+}
+
+bool MessageCache::has(int msg_id) {
+    sqlite3_stmt* st = prepare("SELECT 1 FROM messages WHERE id=?");
+    if (!st) return false;
+    sqlite3_bind_int(st, 1, msg_id);
+    bool found = sqlite3_step(st) == SQLITE_ROW;
+    sqlite3_finalize(st);
+    return found;
+}
+
+void MessageCache::store(const std::vector<MessageInfo>& msgs) {
+    if (msgs.empty() || !db_) return;
+    sqlite3_stmt* st = prepare(
+        "INSERT OR REPLACE INTO messages (id,channel_id,author_id,author,content,ts) "
+        "VALUES (?,?,?,?,?,?)");
+    if (!st) return;
+
+    std::set<int> channels;
+    exec("BEGIN");
+    for (auto& m : msgs) {
+        sqlite3_bind_int(st, 1, m.id);
+        sqlite3_bind_int(st, 2, m.channel_id);
+        sqlite3_bind_int(st, 3, m.author_id);
+        sqlite3_bind_text(st, 4, m.author.c_str(),  -1, SQLITE_STATIC);
+        sqlite3_bind_text(st, 5, m.content.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(st, 6, m.ts);
+        if (sqlite3_step(st) != SQLITE_DONE)
+            fprintf(stderr, "[cache] store: %s\n", sqlite3_errmsg(db_));
+        sqlite3_reset(st);
+        channels.insert(m.channel_id);
+    }
+    sqlite3_finalize(st);
+
+    // Trim from the old end so each channel's run stays contiguous
+    sqlite3_stmt* trim = prepare(
+        "DELETE FROM messages WHERE channel_id=?1 AND id < "
+        "(SELECT id FROM messages WHERE channel_id=?1 ORDER BY id DESC LIMIT 1 OFFSET ?2)");
+    if (trim) {
+        for (int ch : channels) {
+            sqlite3_bind_int(trim, 1, ch);
+            sqlite3_bind_int(trim, 2, max_per_channel - 1);
+            sqlite3_step(trim);
+            sqlite3_reset(trim);
+        }
+        sqlite3_finalize(trim);
+    }
+    exec("COMMIT");
+}
+
+void MessageCache::store(const MessageInfo& msg) {
+    store(std::vector<MessageInfo>{msg});
+}
+
+void MessageCache::update_content(int msg_id, const std::string& content) {
+    sqlite3_stmt* st = prepare("UPDATE messages SET content=? WHERE id=?");
+    if (!st) return;
+    sqlite3_bind_text(st, 1, content.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(st, 2, msg_id);
+    sqlite3_step(st);
+    sqlite3_finalize(st);
+}
+
+void MessageCache::remove(int msg_id) {
+    sqlite3_stmt* st = prepare("DELETE FROM messages WHERE id=?");
+    if (!st) return;
+    sqlite3_bind_int(st, 1, msg_id);
+    sqlite3_step(st);
+    sqlite3_finalize(st);
+}
+
+void MessageCache::clear_channel(int channel_id) {
+    sqlite3_stmt* st = prepare("DELETE FROM messages WHERE channel_id=?");
+    if (!st) return;
+    sqlite3_bind_int(st, 1, channel_id);
+    sqlite3_step(st);
+    sqlite3_finalize(st);
+}
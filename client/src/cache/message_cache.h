@@ -0,0 +1,59 @@
+#pragma once
+#include "../state.h"
+
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// On-disk message history (SQLite), one file per server endpoint and user.
+//
+// For each channel the file holds one contiguous run of message ids, i.e. no
+// gaps: callers only store a page that joins the cached run, and call
+// clear_channel() first when it does not. That makes "everything after the
+// newest cached id" a valid delta request.
+// Not thread-safe; used from the UI thread only.
+
+class MessageCache {
+public:
+    MessageCache() = default;
+    ~MessageCache();
+
+    MessageCache(const MessageCache&)            = delete;
+    MessageCache& operator=(const MessageCache&) = delete;
+
+    // Open (creating if needed) the cache file at `path`.
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return db_ != nullptr; }
+
+    // Up to `limit` cached messages of `channel_id` in chronological order:
+    // the newest ones, or the ones just before `before_id` when it is > 0.
+    std::vector<MessageInfo> load(int channel_id, int limit, int before_id = 0);
+
+    // Newest cached message id of `channel_id`, 0 if none.
+    int  newest_id(int channel_id);
+    bool has(int msg_id);
+
+    // Insert or replace messages (one transaction), then drop the oldest ones
+    // of each touched channel beyond max_per_channel.
+    void store(const std::vector<MessageInfo>& msgs);
+    void store(const MessageInfo& msg);
+
+    void update_content(int msg_id, const std::string& content);
+    void remove(int msg_id);
+    void clear_channel(int channel_id);
+
+    int max_per_channel = 5000;
+
+private:
+    sqlite3* db_ = nullptr;
+
+    bool          exec(const char* sql);
+    sqlite3_stmt* prepare(const char* sql);
+};
+
+// Cache file name for a server endpoint and user, e.g.
+// "cache-127.0.0.1-8080-u3.db". Characters unsafe in file names become '_'.
+std::string message_cache_file(const std::string& host, int port, int user_id);
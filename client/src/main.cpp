@@ -7,15 +7,56 @@
 #include <imgui_impl_sdl2.h>
 #include <imgui_impl_opengl3.h>
 
+#include <atomic>
 #include <cstdio>
-#include <memory>
 #include "state.h"
 #include "net/http_client.h"
 #include "net/ws_client.h"
 #include "net/voice_client.h"
+#include "ui/glyph_cache.h"
 #include "ui/login_screen.h"
 #include "ui/main_screen.h"
 
+#ifndef NDEBUG
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+#endif
+
+// ─── Idle rendering ───────────────────────────────────────────────────────────
+// Frames are only built while something may change. After any event (input,
+// a wake from the network threads) a few frames are drawn so ImGui can settle
+// (hover state, popups, scroll requests applied next frame); then the loop
+// blocks in SDL_WaitEventTimeout. The timeout keeps UI timers such as the
+// text cursor blink running at a low rate.
+static const int    SETTLE_FRAMES    = 3;
+static const Uint32 IDLE_TIMEOUT_MS  = 1000;
+static const Uint32 BLINK_TIMEOUT_MS = 200;   // while a text field has focus
+
+#ifndef NDEBUG
+// CPU time used by this process so far, in seconds.
+static double process_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME create, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user))
+        return 0.0;
+    auto secs = [](const FILETIME& ft) {
+        return (double)(((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime) * 1e-7;
+    };
+    return secs(kernel) + secs(user);
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0.0;
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+#endif
+
 int main(int /*argc*/, char* /*argv*/[]) {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
         fprintf(stderr, "[SDL] Init error: %s\n", SDL_GetError());
@@ -150,22 +191,68 @@ int main(int /*argc*/, char* /*argv*/[]) {
     ImGui_ImplSDL2_InitForOpenGL(window, gl_ctx);
     ImGui_ImplOpenGL3_Init("#version 330");
 
+    // Unicode text: glyphs are baked as messages need them
+    GlyphCache glyphs;
+    glyphs.init(15.f);
+
     // ── App objects ──────────────────────────────────────────────────────────
     AppState state;
-    std::unique_ptr<HttpClient> http =
-        std::make_unique<HttpClient>(state.server_host, state.server_port);
+    if (char* pref = SDL_GetPrefPath("NoriChat", "norichat")) {
+        state.data_dir = pref;
+        SDL_free(pref);
+    }
+    HttpClient  http(state.server_host, state.server_port);
     WsClient    ws;
     VoiceClient voice;
     LoginScreen login_screen;
-    MainScreen  main_screen;
+    MainScreen  main_screen(glyphs);
+
+    // Network threads wake the loop with a user event; at most one is queued.
+    const Uint32      wake_event = SDL_RegisterEvents(1);
+    std::atomic<bool> wake_pending{false};
+    auto wake_ui = [wake_event, &wake_pending] {
+        if (wake_event == (Uint32)-1 || wake_pending.exchange(true)) return;
+        SDL_Event e{};
+        e.type = wake_event;
+        SDL_PushEvent(&e);
+    };
+    http.set_on_wake(wake_ui);
+    ws.set_on_wake(wake_ui);
+
+    // Received audio is played from the WS thread, without a UI frame
+    ws.set_on_voice_data([&voice](const std::string& b64, int ch_id) {
+        if (voice.is_active() && voice.voice_channel_id() == ch_id)
+            voice.play_frame(b64);
+    });
 
     const ImVec4 clear_color(0.04f, 0.07f, 0.12f, 1.f); // LCARS deep navy
     bool running = true;
+    int  busy_frames = SETTLE_FRAMES;   // frames to build before blocking again
+
+#ifndef NDEBUG
+    int    stat_frames = 0;
+    Uint64 stat_start  = SDL_GetPerformanceCounter();
+    double stat_cpu    = process_cpu_seconds();
+    float  shown_fps   = 0.f, shown_cpu = 0.f;
+#endif
 
     // ── Main loop ────────────────────────────────────────────────────────────
     while (running) {
         SDL_Event event;
-        while (SDL_PollEvent(&event)) {
+        int got;
+        if (busy_frames > 0) {
+            got = SDL_PollEvent(&event);
+        } else {
+            // Wakes on input, a wake_event or the timeout
+            got = SDL_WaitEventTimeout(&event, io.WantTextInput ? BLINK_TIMEOUT_MS
+                                                                : IDLE_TIMEOUT_MS);
+        }
+        for (; got; got = SDL_PollEvent(&event)) {
+            busy_frames = SETTLE_FRAMES;
+            if (event.type == wake_event) {
+                wake_pending = false;
+                continue;
+            }
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
                 running = false;
@@ -174,19 +261,11 @@ int main(int /*argc*/, char* /*argv*/[]) {
                 event.window.windowID == SDL_GetWindowID(window))
                 running = false;
         }
+        if (busy_frames > 0) busy_frames--;
 
-        // Re-create HttpClient if server address changed
-        {
-            static char last_host[128] = {};
-            static int  last_port      = 0;
-            if (strcmp(last_host, state.server_host) != 0 ||
-                last_port != state.server_port) {
-                strncpy(last_host, state.server_host, sizeof(last_host) - 1);
-                last_port = state.server_port;
-                http = std::make_unique<HttpClient>(state.server_host,
-                                                    state.server_port);
-            }
-        }
+        // Completed HTTP requests: callbacks update `state` before this
+        // frame is built. The endpoint is (re)set by LoginScreen on submit.
+        http.poll();
 
         // ImGui new frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -210,15 +289,48 @@ int main(int /*argc*/, char* /*argv*/[]) {
         // Dispatch to current screen
         switch (state.screen) {
         case AppState::Screen::Login:
-            login_screen.render(state, *http, ws);
+            login_screen.render(state, http, ws);
             break;
         case AppState::Screen::Main:
-            main_screen.update(state, *http, ws, voice);
+            main_screen.update(state, http, ws, voice);
             break;
         }
 
-        // Render
+#ifndef NDEBUG
+        // Frame rate and process CPU, averaged over about a second
+        {
+            stat_frames++;
+            Uint64 now  = SDL_GetPerformanceCounter();
+            double wall = (double)(now - stat_start) / SDL_GetPerformanceFrequency();
+            if (wall >= 1.0) {
+                double cpu = process_cpu_seconds();
+                shown_fps   = (float)(stat_frames / wall);
+                shown_cpu   = (float)((cpu - stat_cpu) / wall * 100.0);
+                stat_frames = 0;
+                stat_start  = now;
+                stat_cpu    = cpu;
+            }
+            ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 4.f, io.DisplaySize.y - 4.f),
+                                    ImGuiCond_Always, ImVec2(1.f, 1.f));
+            ImGui::SetNextWindowBgAlpha(0.6f);
+            ImGui::Begin("##frame_stats", nullptr,
+                         ImGuiWindowFlags_NoDecoration       |
+                         ImGuiWindowFlags_NoInputs           |
+                         ImGuiWindowFlags_AlwaysAutoResize   |
+                         ImGuiWindowFlags_NoFocusOnAppearing |
+                         ImGuiWindowFlags_NoNav);
+            ImGui::TextDisabled("%.0f fps  cpu %.1f%%", shown_fps, shown_cpu);
+            ImGui::End();
+        }
+#endif
+
+        // Render. A minimized window is not drawn: swapping it may not block
+        // on vsync, and nothing is visible anyway.
         ImGui::Render();
+        if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) {
+            busy_frames = 0;
+            continue;
+        }
         int w, h;
         SDL_GetWindowSize(window, &w, &h);
         glViewport(0, 0, w, h);
@@ -227,6 +339,9 @@ int main(int /*argc*/, char* /*argv*/[]) {
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         SDL_GL_SwapWindow(window);
+
+        // Glyphs for text first drawn this frame; draw again once baked
+        if (glyphs.update() && busy_frames == 0) busy_frames = 1;
     }
 
     // ── Cleanup ──────────────────────────────────────────────────────────────
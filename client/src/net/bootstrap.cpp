@@ -0,0 +1,72 @@
+#include "bootstrap.h"
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+using json = nlohmann::json;
+
+// Apply a bootstrap response body to `state`. False if it does not parse.
+static bool apply_bootstrap(AppState& state, const std::string& body) {
+    json j;
+    try { j = json::parse(body); }
+    catch (...) { return false; }
+
+    state.servers.clear();
+    for (auto& o : j.value("servers", json::array()))
+        state.servers.push_back({o.value("id", 0), o.value("name", "?")});
+
+    state.selected_server_id = j.value("server_id", -1);
+
+    state.channels.clear();
+    for (auto& o : j.value("channels", json::array()))
+        state.channels.push_back({o.value("id", 0),
+                                  o.value("server_id", 0),
+                                  o.value("name", "?"),
+                                  o.value("type", "text")});
+
+    // Members are not part of the response (lazy_members); MainScreen
+    // subscribes to the window of them it shows
+    state.members.clear();
+    state.members_server_id = -1;
+    state.members_start     = 0;
+    state.members_online    = 0;
+    state.members_total     = 0;
+
+    state.selected_channel_id = j.value("channel_id", -1);
+    {
+        // Stores of the previous server's channels are dropped with it
+        std::lock_guard<std::mutex> lk(state.msg_mutex);
+        state.channel_stores.clear();
+        std::vector<MessageInfo> msgs;
+        for (auto& o : j.value("messages", json::array())) {
+            MessageInfo m;
+            m.id         = o.value("id", 0);
+            m.channel_id = o.value("channel_id", 0);
+            m.author_id  = o.value("author_id", 0);
+            m.author     = o.value("author", "?");
+            m.content    = o.value("content", "");
+            m.ts         = o.value("ts", (int64_t)0);
+            msgs.push_back(m);
+        }
+        if (state.selected_channel_id >= 0) {
+            ChannelStore& st = state.store(state.selected_channel_id);
+            st.has_older = !msgs.empty();
+            st.loaded    = true;
+            st.assign(std::move(msgs));
+        }
+        state.scroll_to_bottom = true;
+    }
+    return true;
+}
+
+void load_bootstrap(AppState& state, HttpClient& http, int server_id,
+                    std::function<void(bool ok)> done) {
+    std::string path = "/api/bootstrap?lazy_members=1";
+    if (server_id >= 0) path += "&server_id=" + std::to_string(server_id);
+
+    http.get(path, state.auth_token,
+             [&state, done = std::move(done)](std::optional<HttpResponse> resp) {
+        bool ok = resp && resp->status_code == 200 && apply_bootstrap(state, resp->body);
+        if (done) done(ok);
+    });
+}
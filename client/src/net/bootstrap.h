@@ -0,0 +1,15 @@
+#pragma once
+#include "../state.h"
+#include "http_client.h"
+
+#include <functional>
+
+// Fetch GET /api/bootstrap and load the result into `state`: the server list,
+// plus channels and recent history of `server_id` (-1 = the server's
+// default, i.e. the user's first server) and its first text channel, which
+// becomes the selected channel. Replaces all channel stores with one for that
+// channel and empties the member list, which is filled over the WebSocket.
+// Asynchronous: `done(ok)` runs from http.poll() once the response is
+// applied; on failure `state` is left untouched.
+void load_bootstrap(AppState& state, HttpClient& http, int server_id,
+                    std::function<void(bool ok)> done);
@@ -1,6 +1,6 @@
 #include "http_client.h"
 
-#include <curl/curl.h>
+#include <algorithm>
 #include <cstdio>
 
 // ─── libcurl global init (RAII, once per process) ─────────────────────────────
@@ -11,6 +11,27 @@ struct CurlGlobal {
 } g_curl;
 } // namespace
 
+// ─── Request ──────────────────────────────────────────────────────────────────
+
+// One transfer. Built on the UI thread, owned by the worker while in flight,
+// handed back through done_ and deleted after its callback has run.
+struct HttpClient::Request {
+    std::string  method;
+    std::string  url;
+    std::string  body;
+    curl_slist*  headers = nullptr;
+    CURL*        easy    = nullptr;
+
+    std::optional<HttpResponse> result;
+    std::string                 response_body;
+    Callback                    cb;
+
+    ~Request() {
+        curl_slist_free_all(headers);
+        if (easy) curl_easy_cleanup(easy);
+    }
+};
+
 // ─── Write callback ───────────────────────────────────────────────────────────
 
 static size_t write_cb(char* data, size_t size, size_t nmemb, void* userp) {
@@ -20,60 +41,168 @@ static size_t write_cb(char* data, size_t size, size_t nmemb, void* userp) {
 
 // ─── HttpClient ───────────────────────────────────────────────────────────────
 
-HttpClient::HttpClient(const std::string& host, int port)
-    : host_(host), port_(port) {}
+HttpClient::HttpClient(const std::string& host, int port) {
+    set_endpoint(host, port);
+    multi_ = curl_multi_init();
+    if (!multi_) { fprintf(stderr, "[http] curl_multi_init failed\n"); return; }
+    curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, 4L);
+    worker_ = std::thread(&HttpClient::worker_fn, this);
+}
+
+HttpClient::~HttpClient() {
+    stop_ = true;
+    if (multi_) curl_multi_wakeup(multi_);
+    if (worker_.joinable()) worker_.join();
 
-std::optional<HttpResponse>
-HttpClient::post(const std::string& path, const std::string& json_body,
-                 const std::string& auth_token) {
-    return do_request("POST", path, json_body, auth_token);
+    // Callbacks of unfinished transfers are dropped, not run
+    for (Request* r : queued_) delete r;
+    for (Request* r : done_)   delete r;
+    if (multi_) curl_multi_cleanup(multi_);
 }
 
-std::optional<HttpResponse>
-HttpClient::get(const std::string& path, const std::string& auth_token) {
-    return do_request("GET", path, "", auth_token);
+void HttpClient::set_endpoint(const std::string& host, int port) {
+    if (host == host_ && port == port_) return;
+    host_     = host;
+    port_     = port;
+    base_url_ = "http://" + host_ + ":" + std::to_string(port_);
 }
 
-std::optional<HttpResponse>
-HttpClient::do_request(const std::string& method, const std::string& path,
-                       const std::string& body,   const std::string& auth_token) {
-    CURL* curl = curl_easy_init();
-    if (!curl) { fprintf(stderr, "[http] curl_easy_init failed\n"); return std::nullopt; }
+void HttpClient::post(const std::string& path, const std::string& json_body,
+                      const std::string& auth_token, Callback cb) {
+    submit("POST", path, json_body, auth_token, std::move(cb));
+}
 
-    std::string url = "http://" + host_ + ":" + std::to_string(port_) + path;
-    std::string response_body;
+void HttpClient::get(const std::string& path, const std::string& auth_token,
+                     Callback cb) {
+    submit("GET", path, "", auth_token, std::move(cb));
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL,            url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,  write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA,      &response_body);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT,        10L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+void HttpClient::submit(const std::string& method, const std::string& path,
+                        const std::string& body,   const std::string& auth_token,
+                        Callback cb) {
+    auto* r   = new Request;
+    r->method = method;
+    r->url    = base_url_ + path;
+    r->body   = body;
+    r->cb     = std::move(cb);
 
-    curl_slist* hdrs = nullptr;
-    hdrs = curl_slist_append(hdrs, "Content-Type: application/json");
+    r->headers = curl_slist_append(r->headers, "Content-Type: application/json");
     if (!auth_token.empty()) {
         std::string auth_hdr = "Authorization: Bearer " + auth_token;
-        hdrs = curl_slist_append(hdrs, auth_hdr.c_str());
+        r->headers = curl_slist_append(r->headers, auth_hdr.c_str());
     }
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdrs);
 
-    if (method == "POST") {
-        curl_easy_setopt(curl, CURLOPT_POST,          1L);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS,    body.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)body.size());
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (multi_) queued_.push_back(r);
+        else        done_.push_back(r);     // no worker: fail on next poll()
     }
+    if (multi_) curl_multi_wakeup(multi_);
+}
+
+void HttpClient::set_on_wake(WakeCallback cb) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    on_wake_ = std::move(cb);
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    long status  = 0;
-    if (res == CURLE_OK)
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
-    else
-        fprintf(stderr, "[http] %s %s : %s\n",
-                method.c_str(), url.c_str(), curl_easy_strerror(res));
+void HttpClient::poll() {
+    std::deque<Request*> finished;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        finished.swap(done_);
+    }
+    for (Request* r : finished) {
+        if (r->cb) r->cb(std::move(r->result));
+        delete r;
+    }
+}
 
-    curl_slist_free_all(hdrs);
-    curl_easy_cleanup(curl);
+// ─── Worker thread ────────────────────────────────────────────────────────────
+
+void HttpClient::worker_fn() {
+    CURLM* multi = multi_;
+    std::vector<Request*> active;
+
+    while (!stop_) {
+        bool finished = false;
+        std::deque<Request*> incoming;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            incoming.swap(queued_);
+        }
+        for (Request* r : incoming) {
+            CURL* easy = curl_easy_init();
+            if (!easy) {
+                fprintf(stderr, "[http] curl_easy_init failed\n");
+                std::lock_guard<std::mutex> lk(mutex_);
+                done_.push_back(r);
+                finished = true;
+                continue;
+            }
+            r->easy = easy;
+            curl_easy_setopt(easy, CURLOPT_URL,            r->url.c_str());
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,  write_cb);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA,      &r->response_body);
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT,        10L);
+            curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 5L);
+            curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE,  1L);
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER,     r->headers);
+            curl_easy_setopt(easy, CURLOPT_PRIVATE,        r);
+            if (r->method == "POST") {
+                curl_easy_setopt(easy, CURLOPT_POST,          1L);
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDS,    r->body.c_str());
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, (long)r->body.size());
+            }
+            curl_multi_add_handle(multi, easy);
+            active.push_back(r);
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int      left = 0;
+        CURLMsg* msg;
+        while ((msg = curl_multi_info_read(multi, &left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Request* r = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &r);
+
+            CURLcode res = msg->data.result;
+            if (res == CURLE_OK) {
+                long status = 0;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+                r->result = HttpResponse{(int)status, std::move(r->response_body)};
+            } else {
+                fprintf(stderr, "[http] %s %s : %s\n",
+                        r->method.c_str(), r->url.c_str(), curl_easy_strerror(res));
+            }
+
+            // The connection stays in the multi handle's cache for reuse
+            curl_multi_remove_handle(multi, msg->easy_handle);
+            curl_easy_cleanup(msg->easy_handle);
+            r->easy = nullptr;
+            active.erase(std::find(active.begin(), active.end(), r));
+
+            std::lock_guard<std::mutex> lk(mutex_);
+            done_.push_back(r);
+            finished = true;
+        }
+
+        if (finished) {
+            WakeCallback wake;
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                wake = on_wake_;
+            }
+            if (wake) wake();
+        }
+
+        // Sleeps until socket activity, a curl timeout or curl_multi_wakeup()
+        curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
 
-    if (res != CURLE_OK) return std::nullopt;
-    return HttpResponse{(int)status, std::move(response_body)};
+    for (Request* r : active) {
+        curl_multi_remove_handle(multi, r->easy);
+        delete r;
+    }
 }
@@ -1,9 +1,24 @@
 #pragma once
-#include <string>
+#include <curl/curl.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
-// Synchronous HTTP client backed by libcurl.
+// Asynchronous HTTP client backed by libcurl.
 // Cross-platform: Windows and Linux.
+//
+// Transfers run on a background thread driving one curl_multi handle, whose
+// connection cache keeps connections to the server alive between requests.
+// get()/post() return immediately; the callback runs on the UI thread from
+// poll(), with std::nullopt if the transfer failed (no HTTP status).
+// The optional wake callback runs on the worker thread whenever a transfer
+// finishes, to get an idle UI thread to call poll().
+// All public methods must be called from the UI thread.
 
 struct HttpResponse {
     int         status_code = 0;
@@ -12,22 +27,47 @@ struct HttpResponse {
 
 class HttpClient {
 public:
+    using Callback     = std::function<void(std::optional<HttpResponse>)>;
+    using WakeCallback = std::function<void()>;
+
     HttpClient(const std::string& host, int port);
-    ~HttpClient() = default;
+    ~HttpClient();
+
+    HttpClient(const HttpClient&)            = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // Point subsequent requests at host:port. No-op if unchanged; requests
+    // already in flight finish against the old endpoint.
+    void set_endpoint(const std::string& host, int port);
 
-    std::optional<HttpResponse> post(const std::string& path,
-                                     const std::string& json_body,
-                                     const std::string& auth_token = "");
+    void post(const std::string& path, const std::string& json_body,
+              const std::string& auth_token, Callback cb);
 
-    std::optional<HttpResponse> get(const std::string& path,
-                                    const std::string& auth_token = "");
+    void get(const std::string& path, const std::string& auth_token, Callback cb);
+
+    // Run the callbacks of finished transfers. Call once per frame.
+    void poll();
+
+    void set_on_wake(WakeCallback cb);
 
 private:
+    struct Request;   // defined in http_client.cpp
+
+    std::string base_url_;   // "http://host:port", UI thread only
     std::string host_;
-    int         port_;
+    int         port_     = 0;
+
+    CURLM*            multi_  = nullptr;
+    std::thread       worker_;
+    std::atomic<bool> stop_{false};
+
+    std::mutex            mutex_;       // guards queued_, done_ and on_wake_
+    std::deque<Request*>  queued_;      // submitted, not yet added to multi_
+    std::deque<Request*>  done_;        // finished, callback not yet run
+    WakeCallback          on_wake_;
 
-    std::optional<HttpResponse> do_request(const std::string& method,
-                                           const std::string& path,
-                                           const std::string& body,
-                                           const std::string& auth_token);
+    void submit(const std::string& method, const std::string& path,
+                const std::string& body, const std::string& auth_token,
+                Callback cb);
+    void worker_fn();
 };
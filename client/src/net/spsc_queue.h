@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// Unbounded single-producer / single-consumer queue without locks.
+// push() must always be called from the same thread, and pop() from one
+// other thread. Nodes are linked through atomic next pointers; head_ is a
+// dummy node owned by the consumer, whose successor is the front element.
+
+template <typename T>
+class SpscQueue {
+public:
+    SpscQueue() : head_(new Node), tail_(head_) {}
+    ~SpscQueue() {
+        while (Node* n = head_) {
+            head_ = n->next.load(std::memory_order_relaxed);
+            delete n;
+        }
+    }
+
+    SpscQueue(const SpscQueue&)            = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side.
+    void push(T value) {
+        Node* n  = new Node;
+        n->value = std::move(value);
+        tail_->next.store(n, std::memory_order_release);
+        tail_ = n;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T& out) {
+        Node* next = head_->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        out = std::move(next->value);
+        delete head_;
+        head_ = next;
+        return true;
+    }
+
+private:
+    struct Node {
+        T                  value{};
+        std::atomic<Node*> next{nullptr};
+    };
+
+    alignas(64) Node* head_;   // consumer only
+    alignas(64) Node* tail_;   // producer only
+};
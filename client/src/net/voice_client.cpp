@@ -119,7 +119,7 @@ bool VoiceClient::start(int channel_id, FrameCallback on_frame) {
     ma_device_start(cap_dev_);
     ma_device_start(play_dev_);
     active_ = true;
-    fprintf(stdout, "[voice] started, channel=%d\n", channel_id_);
+    fprintf(stdout, "[voice] started, channel=%d\n", channel_id_.load());
     return true;
 }
 
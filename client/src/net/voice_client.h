@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
 #include <deque>
 #include <functional>
@@ -34,7 +35,8 @@ public:
     // Stop capture and playback and release audio devices.
     void stop();
 
-    // Queue base64-encoded PCM from the server for playback.  Thread-safe.
+    // Queue base64-encoded PCM from the server for playback.  Thread-safe;
+    // called from the WebSocket thread.
     void play_frame(const std::string& b64_pcm);
 
     bool is_active()        const { return active_; }
@@ -47,11 +49,11 @@ private:
     static void playback_cb(ma_device* dev, void* out, const void* in,
                             unsigned int frame_count);
 
-    ma_device*    cap_dev_   = nullptr;
-    ma_device*    play_dev_  = nullptr;
-    bool          active_    = false;
-    int           channel_id_ = -1;
-    FrameCallback on_frame_;
+    ma_device*        cap_dev_  = nullptr;
+    ma_device*        play_dev_ = nullptr;
+    std::atomic<bool> active_{false};      // also read on the WS and audio threads
+    std::atomic<int>  channel_id_{-1};
+    FrameCallback     on_frame_;
 
     static constexpr int SAMPLE_RATE   = 16000;
     static constexpr int FRAME_SAMPLES = 320;  // 20 ms @ 16 kHz, mono
@@ -1,5 +1,6 @@
 #include "ws_client.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <vector>
@@ -31,6 +32,22 @@ static lws_protocols g_protocols[] = {
     { nullptr, nullptr, 0, 0 }
 };
 
+// ─── Reconnect backoff ────────────────────────────────────────────────────────
+
+static const int BACKOFF_MIN_MS = 500;
+static const int BACKOFF_MAX_MS = 30000;
+
+// Ping the server after 20 s without traffic and drop the connection after
+// 60 s, so a half-open connection ends in a reconnect rather than silence.
+static lws_retry_bo_t heartbeat_policy() {
+    lws_retry_bo_t p;
+    memset(&p, 0, sizeof(p));
+    p.secs_since_valid_ping   = 20;
+    p.secs_since_valid_hangup = 60;
+    return p;
+}
+static const lws_retry_bo_t HEARTBEAT = heartbeat_policy();
+
 // ─── WsClient ─────────────────────────────────────────────────────────────────
 
 WsClient::WsClient()  = default;
@@ -38,8 +55,16 @@ WsClient::~WsClient() { disconnect(); }
 
 bool WsClient::connect(const std::string& host, int port,
                        const std::string& token) {
-    token_   = token;
-    running_ = true;
+    host_       = host;
+    port_       = port;
+    token_      = token;
+    backoff_ms_ = BACKOFF_MIN_MS;
+    {
+        std::lock_guard<std::mutex> lock(resume_mutex_);
+        resume_epoch_ = 0;
+        resume_seq_   = 0;
+        resume_channels_.clear();
+    }
 
     lws_context_creation_info info;
     memset(&info, 0, sizeof(info));
@@ -53,46 +78,76 @@ bool WsClient::connect(const std::string& host, int port,
     ctx_ = lws_create_context(&info);
     if (!ctx_) {
         fprintf(stderr, "[ws_client] failed to create lws context\n");
-        running_ = false;
-        return false;
-    }
-
-    // Initiate connection
-    lws_client_connect_info cci;
-    memset(&cci, 0, sizeof(cci));
-    cci.context        = ctx_;
-    cci.address        = host.c_str();
-    cci.port           = port;
-    cci.path           = "/ws";
-    cci.host           = host.c_str();
-    cci.origin         = host.c_str();
-    cci.protocol       = g_protocols[0].name;
-    cci.ssl_connection = 0; // plain ws://
-
-    wsi_ = lws_client_connect_via_info(&cci);
-    if (!wsi_) {
-        fprintf(stderr, "[ws_client] lws_client_connect_via_info failed\n");
-        lws_context_destroy(ctx_);
-        ctx_     = nullptr;
-        running_ = false;
         return false;
     }
+    running_               = true;
+    reconnect_timer_.owner = this;
 
-    // Start background service thread
+    // First attempt; the service thread takes over lws from here on
+    attempt_connect();
     service_thread_ = std::thread(&WsClient::service_thread_fn, this);
     return true;
 }
 
 void WsClient::disconnect() {
     running_ = false;
+    if (ctx_) lws_cancel_service(ctx_);
     if (service_thread_.joinable())
         service_thread_.join();
     if (ctx_) {
+        lws_sul_cancel(&reconnect_timer_.sul);
         lws_context_destroy(ctx_);
         ctx_ = nullptr;
     }
     wsi_       = nullptr;
     connected_ = false;
+    recv_buf_.clear();
+}
+
+void WsClient::set_resume(int64_t epoch, uint64_t last_seq,
+                          std::vector<int> channels) {
+    std::lock_guard<std::mutex> lock(resume_mutex_);
+    resume_epoch_    = epoch;
+    resume_seq_      = last_seq;
+    resume_channels_ = std::move(channels);
+}
+
+void WsClient::attempt_connect() {
+    lws_client_connect_info cci;
+    memset(&cci, 0, sizeof(cci));
+    cci.context        = ctx_;
+    cci.address        = host_.c_str();
+    cci.port           = port_;
+    cci.path           = "/ws";
+    cci.host           = host_.c_str();
+    cci.origin         = host_.c_str();
+    cci.protocol       = g_protocols[0].name;
+    cci.ssl_connection = 0; // plain ws://
+    cci.retry_and_idle_policy = &HEARTBEAT;
+
+    wsi_ = lws_client_connect_via_info(&cci);
+    if (!wsi_) {
+        fprintf(stderr, "[ws_client] lws_client_connect_via_info failed\n");
+        schedule_reconnect();
+    }
+}
+
+// Retry after a random delay in [backoff/2, backoff], doubling the backoff
+// each time, so clients dropped together do not reconnect in lockstep.
+void WsClient::schedule_reconnect() {
+    if (!running_) return;
+    std::uniform_int_distribution<int> jitter(backoff_ms_ / 2, backoff_ms_);
+    int delay_ms = jitter(rng_);
+    backoff_ms_  = std::min(backoff_ms_ * 2, BACKOFF_MAX_MS);
+
+    fprintf(stdout, "[ws_client] reconnecting in %d ms\n", delay_ms);
+    lws_sul_schedule(ctx_, 0, &reconnect_timer_.sul, reconnect_cb,
+                     (lws_usec_t)delay_ms * LWS_US_PER_MS);
+}
+
+void WsClient::reconnect_cb(lws_sorted_usec_list_t* sul) {
+    WsClient* self = reinterpret_cast<ReconnectTimer*>(sul)->owner;
+    if (self->running_) self->attempt_connect();
 }
 
 void WsClient::send(const std::string& json_msg) {
@@ -107,15 +162,11 @@ void WsClient::send(const std::string& json_msg) {
 
 // ─── Service loop (background thread) ────────────────────────────────────────
 
+// Blocks in lws_service() until socket activity, the reconnect timer or
+// lws_cancel_service() from send()/disconnect().
 void WsClient::service_thread_fn() {
     while (running_) {
-        // Request writable callback from within the service thread (thread-safe).
-        {
-            std::lock_guard<std::mutex> lock(send_mutex_);
-            if (!send_queue_.empty() && wsi_ && connected_)
-                lws_callback_on_writable(wsi_);
-        }
-        lws_service(ctx_, 50); // 50 ms timeout
+        if (lws_service(ctx_, 0) < 0) break;
     }
 }
 
@@ -125,14 +176,29 @@ int WsClient::on_lws_event(lws* wsi, lws_callback_reasons reason,
                            void* in, size_t len) {
     switch (reason) {
     case LWS_CALLBACK_CLIENT_ESTABLISHED:
-        connected_ = true;
+        connected_  = true;
+        backoff_ms_ = BACKOFF_MIN_MS;
         fprintf(stdout, "[ws_client] connected to server\n");
-        // First thing: authenticate
+        // First thing: authenticate (or resume the previous event stream).
+        // It goes in front of anything queued while we were disconnected.
         {
             json auth_msg;
-            auth_msg["op"]    = "AUTH";
-            auth_msg["token"] = token_;
-            send(auth_msg.dump());
+            auth_msg["token"]        = token_;
+            auth_msg["lazy_members"] = true;   // members come as MEMBER_LIST windows
+            {
+                std::lock_guard<std::mutex> lock(resume_mutex_);
+                if (resume_epoch_ != 0) {
+                    auth_msg["op"]       = "RESUME";
+                    auth_msg["epoch"]    = resume_epoch_;
+                    auth_msg["last_seq"] = resume_seq_;
+                    auth_msg["channels"] = resume_channels_;
+                } else {
+                    auth_msg["op"] = "AUTH";
+                }
+            }
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            send_queue_.push_front(auth_msg.dump());
+            lws_callback_on_writable(wsi);
         }
         break;
 
@@ -143,7 +209,15 @@ int WsClient::on_lws_event(lws* wsi, lws_callback_reasons reason,
         std::string complete = std::move(recv_buf_);
         recv_buf_.clear();
 
-        if (on_message_) on_message_(complete);
+        auto ev = decode_ws_event(complete);
+        if (!ev) break;
+        if (auto* vd = std::get_if<VoiceDataEvent>(&ev->body)) {
+            // Audio never waits for a UI frame
+            if (on_voice_data_) on_voice_data_(vd->data, vd->channel_id);
+            break;
+        }
+        events_.push(std::move(*ev));
+        if (on_wake_) on_wake_();
         break;
     }
 
@@ -165,17 +239,32 @@ int WsClient::on_lws_event(lws* wsi, lws_callback_reasons reason,
         break;
     }
 
+    // send() queued something: write it now rather than at the next
+    // socket event
+    case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        if (!send_queue_.empty() && wsi_ && connected_)
+            lws_callback_on_writable(wsi_);
+        break;
+    }
+
     case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
         fprintf(stderr, "[ws_client] connection error: %s\n",
                 in ? (char*)in : "(none)");
         connected_ = false;
-        running_   = false;
+        wsi_       = nullptr;
+        recv_buf_.clear();
+        schedule_reconnect();
+        if (on_wake_) on_wake_();
         break;
 
     case LWS_CALLBACK_CLIENT_CLOSED:
         connected_ = false;
-        running_   = false;
+        wsi_       = nullptr;
+        recv_buf_.clear();
         fprintf(stdout, "[ws_client] connection closed\n");
+        schedule_reconnect();
+        if (on_wake_) on_wake_();
         break;
 
     default:
@@ -1,55 +1,111 @@
 #pragma once
+#include "spsc_queue.h"
+#include "ws_events.h"
+
 #include <libwebsockets.h>
+#include <atomic>
 #include <string>
 #include <deque>
 #include <mutex>
+#include <random>
 #include <thread>
 #include <functional>
+#include <vector>
 
 // Asynchronous WebSocket client.
-// The lws service loop runs in a background thread.
-// Received messages are passed to on_message callback (called from bg thread).
+// The lws service loop runs in a background thread and sleeps until socket
+// activity, a timer or send() waking it.
+// Received frames are decoded into WsEvents on the bg thread. VOICE_DATA goes
+// straight to the voice callback; everything else is queued for the UI
+// thread, which drains it with poll_event().
 // send() is thread-safe.
+//
+// A dropped connection is retried with jittered exponential backoff until
+// disconnect(). Each new connection starts with RESUME from the point given
+// to set_resume(), which also resubscribes the channels, or with AUTH if
+// there is none yet.
 
 class WsClient {
 public:
-    using MessageCallback = std::function<void(const std::string& json)>;
+    using VoiceDataCallback = std::function<void(const std::string& b64_pcm, int ch_id)>;
+    using WakeCallback      = std::function<void()>;
 
     WsClient();
     ~WsClient();
 
-    // Connect to ws://host:port/ws and send AUTH with token.
+    // Connect to ws://host:port/ws and send AUTH with token, reconnecting
+    // whenever the connection is lost.
     // Returns true if the context was created successfully.
     bool connect(const std::string& host, int port, const std::string& token);
 
     // Disconnect and stop the service thread.
     void disconnect();
 
+    // Stream position for reconnects: they send RESUME asking the server to
+    // replay events after `last_seq` on `channels` (thread-safe). Cleared by
+    // connect().
+    void set_resume(int64_t epoch, uint64_t last_seq, std::vector<int> channels);
+
     // Enqueue a JSON message to be sent (thread-safe).
     void send(const std::string& json_msg);
 
     bool is_connected() const { return connected_; }
 
-    // Called from the bg thread when a complete message arrives.
-    void set_on_message(MessageCallback cb) { on_message_ = std::move(cb); }
+    // True from a successful connect() until disconnect(), including while
+    // waiting to reconnect.
+    bool is_active() const { return running_; }
+
+    // Next decoded event, if any. UI thread only (single consumer).
+    bool poll_event(WsEvent& ev) { return events_.pop(ev); }
+
+    // Called from the bg thread for each VOICE_DATA frame. Set before connect().
+    void set_on_voice_data(VoiceDataCallback cb) { on_voice_data_ = std::move(cb); }
+
+    // Called from the bg thread after an event is queued and when the
+    // connection drops, so an idle UI thread knows there is something to
+    // process. Set before connect().
+    void set_on_wake(WakeCallback cb) { on_wake_ = std::move(cb); }
 
     // lws callback – public so the static C shim can access it.
     int on_lws_event(lws* wsi, lws_callback_reasons reason,
                      void* in, size_t len);
 
 private:
+    // Reconnect timer. The sul is the first member so the lws callback can
+    // get back to the client from the sul pointer.
+    struct ReconnectTimer {
+        lws_sorted_usec_list_t sul;
+        WsClient*              owner;
+    };
+
     void service_thread_fn();
+    void attempt_connect();
+    void schedule_reconnect();
+    static void reconnect_cb(lws_sorted_usec_list_t* sul);
+
+    lws_context*      ctx_        = nullptr;
+    lws*              wsi_        = nullptr;   // service thread only
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> running_{false};
+    std::string       host_;
+    int               port_       = 0;
+    std::string       token_;
+
+    ReconnectTimer    reconnect_timer_{};
+    int               backoff_ms_ = 0;         // upper bound of the next delay
+    std::mt19937      rng_{std::random_device{}()};
 
-    lws_context*    ctx_        = nullptr;
-    lws*            wsi_        = nullptr;
-    bool            connected_  = false;
-    volatile bool   running_    = false;
-    std::string     token_;
+    std::mutex       resume_mutex_;
+    int64_t          resume_epoch_    = 0;   // 0 = plain AUTH
+    uint64_t         resume_seq_      = 0;
+    std::vector<int> resume_channels_;
 
     std::mutex              send_mutex_;
     std::deque<std::string> send_queue_;
     std::string             recv_buf_;   // accumulate fragments
 
-    std::thread      service_thread_;
-    MessageCallback  on_message_;
+    std::thread        service_thread_;
+    SpscQueue<WsEvent> events_;         // bg thread → UI thread
+    VoiceDataCallback  on_voice_data_;
+    WakeCallback       on_wake_;
 };
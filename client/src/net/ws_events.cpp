@@ -0,0 +1,110 @@
+#include "ws_events.h"
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────────
+
+MessageInfo parse_message(const json& o) {
+    MessageInfo m;
+    m.id         = o.value("id", 0);
+    m.channel_id = o.value("channel_id", 0);
+    m.author_id  = o.value("author_id", 0);
+    m.author     = o.value("author", "?");
+    m.content    = o.value("content", "");
+    m.ts         = o.value("ts", (int64_t)0);
+    return m;
+}
+
+// [id, ...], skipping anything that is not an integer
+static std::vector<int> parse_ids(const json& msg, const char* key) {
+    std::vector<int> ids;
+    if (!msg.contains(key) || !msg[key].is_array()) return ids;
+    for (auto& v : msg[key])
+        if (v.is_number_integer()) ids.push_back(v.get<int>());
+    return ids;
+}
+
+// ─── Decoding ─────────────────────────────────────────────────────────────────
+
+std::optional<WsEvent> decode_ws_event(const std::string& raw) {
+    try {
+        json msg = json::parse(raw);
+        std::string op = msg.value("op", "");
+
+        WsEvent ev;
+        if (msg.contains("seq") && msg["seq"].is_number_unsigned())
+            ev.seq = msg["seq"].get<uint64_t>();
+
+        if (op == "AUTH_OK") {
+            ev.body = AuthOkEvent{msg.value("epoch", (int64_t)0)};
+        }
+        else if (op == "RESUMED") {
+            ResumedEvent e;
+            e.epoch  = msg.value("epoch", (int64_t)0);
+            e.reload = parse_ids(msg, "reload");
+            ev.body  = std::move(e);
+        }
+        else if (op == "MEMBER_LIST") {
+            MemberListEvent e;
+            e.server_id    = msg.value("server_id", 0);
+            e.start        = msg.value("start", 0);
+            e.online_count = msg.value("online_count", 0);
+            e.total        = msg.value("total", 0);
+            if (msg.contains("members") && msg["members"].is_array())
+                for (auto& o : msg["members"])
+                    e.members.push_back({o.value("user_id", 0),
+                                         o.value("username", "?"),
+                                         o.value("online", false)});
+            ev.body = std::move(e);
+        }
+        else if (op == "MESSAGE_NEW") {
+            ev.body = MessageNewEvent{parse_message(msg)};
+        }
+        else if (op == "MESSAGE_EDITED") {
+            ev.body = MessageEditedEvent{msg.value("message_id", 0),
+                                         msg.value("channel_id", 0),
+                                         msg.value("content", "")};
+        }
+        else if (op == "MESSAGE_DELETED") {
+            ev.body = MessageDeletedEvent{msg.value("message_id", 0),
+                                          msg.value("channel_id", 0)};
+        }
+        else if (op == "VOICE_JOIN_OK") {
+            VoiceJoinOkEvent e;
+            e.channel_id = msg.value("channel_id", -1);
+            if (msg.contains("participants") && msg["participants"].is_array())
+                for (auto& p : msg["participants"])
+                    e.participants.push_back(
+                        {p.value("user_id", 0), p.value("username", "?")});
+            ev.body = std::move(e);
+        }
+        else if (op == "VOICE_JOINED") {
+            ev.body = VoiceJoinedEvent{msg.value("channel_id", -1),
+                                       msg.value("user_id", 0),
+                                       msg.value("username", "?")};
+        }
+        else if (op == "VOICE_LEFT") {
+            ev.body = VoiceLeftEvent{msg.value("channel_id", -1),
+                                     msg.value("user_id", 0)};
+        }
+        else if (op == "VOICE_DATA") {
+            ev.body = VoiceDataEvent{msg.value("channel_id", -1),
+                                     msg.value("data", "")};
+        }
+        else if (op == "RATE_LIMITED") {
+            ev.body = ErrorEvent{"Sending too fast, " + msg.value("for", std::string("message")) +
+                                 " dropped; try again in a moment"};
+        }
+        else if (op == "AUTH_FAIL" || op == "ERROR") {
+            ev.body = ErrorEvent{msg.value("error", "Server error")};
+        }
+        else {
+            return std::nullopt;
+        }
+        return ev;
+    } catch (...) {
+        return std::nullopt;
+    }
+}
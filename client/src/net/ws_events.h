@@ -0,0 +1,88 @@
+#pragma once
+#include "../state.h"
+
+#include <nlohmann/json_fwd.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+// Server → client WebSocket messages, decoded on the WsClient service thread
+// so the UI thread never parses JSON for them. One struct per op.
+
+// The client subscribes with lazy_members, so presence arrives only as
+// MEMBER_LIST windows: the "online" lists of AUTH_OK/RESUMED and
+// PRESENCE_DIFF are neither sent to it nor decoded.
+
+struct AuthOkEvent {                       // AUTH_OK
+    int64_t epoch = 0;
+};
+
+struct ResumedEvent {                      // RESUMED
+    int64_t          epoch = 0;
+    std::vector<int> reload;               // channels the server could not replay
+};
+
+struct MemberListEvent {                   // MEMBER_LIST
+    int                     server_id    = 0;
+    int                     start        = 0;   // row of members[0]
+    int                     online_count = 0;
+    int                     total        = 0;
+    std::vector<MemberInfo> members;
+};
+
+struct MessageNewEvent {                   // MESSAGE_NEW
+    MessageInfo msg;
+};
+
+struct MessageEditedEvent {                // MESSAGE_EDITED
+    int         message_id = 0;
+    int         channel_id = 0;
+    std::string content;
+};
+
+struct MessageDeletedEvent {               // MESSAGE_DELETED
+    int message_id = 0;
+    int channel_id = 0;
+};
+
+struct VoiceJoinOkEvent {                  // VOICE_JOIN_OK
+    int                           channel_id = -1;
+    std::vector<VoiceParticipant> participants;
+};
+
+struct VoiceJoinedEvent {                  // VOICE_JOINED
+    int         channel_id = -1;
+    int         user_id    = 0;
+    std::string username;
+};
+
+struct VoiceLeftEvent {                    // VOICE_LEFT
+    int channel_id = -1;
+    int user_id    = 0;
+};
+
+struct VoiceDataEvent {                    // VOICE_DATA, never queued
+    int         channel_id = -1;
+    std::string data;                      // base64 PCM
+};
+
+struct ErrorEvent {                        // AUTH_FAIL / ERROR
+    std::string error;
+};
+
+struct WsEvent {
+    uint64_t seq = 0;   // position in the server's event stream, 0 if none
+    std::variant<std::monostate,
+                 AuthOkEvent, ResumedEvent, MemberListEvent,
+                 MessageNewEvent, MessageEditedEvent, MessageDeletedEvent,
+                 VoiceJoinOkEvent, VoiceJoinedEvent, VoiceLeftEvent,
+                 VoiceDataEvent, ErrorEvent> body;
+};
+
+// Decode one text frame. std::nullopt for malformed JSON and unknown ops.
+std::optional<WsEvent> decode_ws_event(const std::string& raw);
+
+// A message object as sent in MESSAGE_NEW and by /api/messages.
+MessageInfo parse_message(const nlohmann::json& o);
@@ -1,9 +1,11 @@
 #pragma once
+#include <algorithm>
 #include <string>
 #include <vector>
-#include <deque>
+#include <iterator>
 #include <cstdint>
 #include <mutex>
+#include <unordered_map>
 
 // ─── Domain types (mirror of server-side structs) ─────────────────────────────
 
@@ -26,6 +28,95 @@ struct MessageInfo {
     std::string author;
     std::string content;
     int64_t     ts         = 0;
+
+    // Render cache, UI thread only: formatted time, and the row height laid
+    // out at width `layout_w`. Set layout_w = 0 when content changes.
+    std::string ts_text;
+    float       layout_w   = 0.f;
+    float       layout_h   = 0.f;
+};
+
+// History of one text channel: a contiguous id window over it, at most
+// AppState::history_cap long, plus an id → position map into that window.
+// The map holds ordinals that only change relative to `base`, so evicting
+// or prepending at the front moves `base` instead of renumbering every row.
+struct ChannelStore {
+    std::vector<MessageInfo>         messages;
+    std::unordered_map<int, int64_t> index;      // message id → ordinal
+    int64_t                          base = 0;   // ordinal of messages[0]
+
+    bool has_older = false;  // the server has history before messages.front()
+    bool has_newer = false;  // ... and after messages.back() (tail evicted)
+    bool loaded    = false;  // history fetched; otherwise only live events
+    int  unread    = 0;
+
+    std::vector<MessageInfo> live_tail;   // MESSAGE_NEW held while has_newer
+
+    // View position, restored when the channel is selected again
+    int   anchor_id    = -1;
+    float anchor_delta = 0.f;
+    bool  at_bottom    = true;
+
+    // Position of `id` in messages, or -1.
+    int64_t position(int id) const {
+        auto it = index.find(id);
+        return it == index.end() ? -1 : it->second - base;
+    }
+    MessageInfo* find(int id) {
+        int64_t pos = position(id);
+        return pos < 0 ? nullptr : &messages[(size_t)pos];
+    }
+    void assign(std::vector<MessageInfo> msgs) {
+        messages = std::move(msgs);
+        index.clear();
+        base = 0;
+        for (size_t i = 0; i < messages.size(); i++) index[messages[i].id] = (int64_t)i;
+    }
+    void append(MessageInfo m) {
+        index[m.id] = base + (int64_t)messages.size();
+        messages.push_back(std::move(m));
+    }
+    void append(std::vector<MessageInfo> page) {
+        for (auto& m : page) append(std::move(m));
+    }
+    void prepend(std::vector<MessageInfo> page) {
+        base -= (int64_t)page.size();
+        for (size_t i = 0; i < page.size(); i++) index[page[i].id] = base + (int64_t)i;
+        messages.insert(messages.begin(), std::make_move_iterator(page.begin()),
+                                          std::make_move_iterator(page.end()));
+    }
+    // Renumbers whichever side of the row is shorter.
+    bool erase(int id) {
+        auto it = index.find(id);
+        if (it == index.end()) return false;
+        size_t pos = (size_t)(it->second - base);
+        index.erase(it);
+        if (pos < messages.size() / 2) {
+            for (size_t i = 0; i < pos; i++) index[messages[i].id]++;
+            base++;
+        } else {
+            for (size_t i = pos + 1; i < messages.size(); i++) index[messages[i].id]--;
+        }
+        messages.erase(messages.begin() + pos);
+        return true;
+    }
+    // Drop rows beyond `cap` from the old end (keep_newest) or the new end.
+    // Returns true if anything was evicted.
+    bool trim(size_t cap, bool keep_newest) {
+        if (messages.size() <= cap) return false;
+        size_t n = messages.size() - cap;
+        if (keep_newest) {
+            for (size_t i = 0; i < n; i++) index.erase(messages[i].id);
+            messages.erase(messages.begin(), messages.begin() + n);
+            base += (int64_t)n;
+            has_older = true;
+        } else {
+            for (size_t i = cap; i < messages.size(); i++) index.erase(messages[i].id);
+            messages.erase(messages.end() - n, messages.end());
+            has_newer = true;
+        }
+        return true;
+    }
 };
 
 struct MemberInfo {
@@ -34,6 +125,52 @@ struct MemberInfo {
     bool        online = false;
 };
 
+// Members of one server (the subscribed MEMBER_LIST window), indexed by user
+// id. Entries are map nodes, so pointers to them stay valid until
+// clear()/assign(); the online and offline views hold those pointers sorted
+// by username. Presence changes arrive as a new window, never as patches.
+struct MemberList {
+    const MemberInfo* find(int id) const {
+        auto it = by_id_.find(id);
+        return it == by_id_.end() ? nullptr : &it->second;
+    }
+    const std::vector<MemberInfo*>& online()  const { return online_; }
+    const std::vector<MemberInfo*>& offline() const { return offline_; }
+    size_t size() const { return by_id_.size(); }
+
+    void clear() {
+        by_id_.clear();
+        online_.clear();
+        offline_.clear();
+    }
+    // Replace everything, sorting the views once.
+    void assign(const std::vector<MemberInfo>& members) {
+        clear();
+        by_id_.reserve(members.size());
+        for (auto& m : members) by_id_[m.id] = m;
+        rebuild_views();
+    }
+
+private:
+    std::unordered_map<int, MemberInfo> by_id_;
+    std::vector<MemberInfo*>            online_;    // sorted by before()
+    std::vector<MemberInfo*>            offline_;
+
+    static bool before(const MemberInfo* a, const MemberInfo* b) {
+        return a->username != b->username ? a->username < b->username : a->id < b->id;
+    }
+    std::vector<MemberInfo*>& view_of(const MemberInfo* m) {
+        return m->online ? online_ : offline_;
+    }
+    void rebuild_views() {
+        online_.clear();
+        offline_.clear();
+        for (auto& [id, m] : by_id_) view_of(&m).push_back(&m);
+        std::sort(online_.begin(),  online_.end(),  before);
+        std::sort(offline_.begin(), offline_.end(), before);
+    }
+};
+
 struct VoiceParticipant {
     int         user_id  = 0;
     std::string username;
@@ -48,6 +185,10 @@ struct AppState {
     char server_host[128] = "127.0.0.1";
     int  server_port      = 8080;
 
+    // Per-user writable directory (SDL pref path, trailing separator) for the
+    // message cache; empty = no on-disk cache
+    std::string data_dir;
+
     // Auth
     std::string auth_token;
     int         user_id  = 0;
@@ -60,16 +201,26 @@ struct AppState {
     // Loaded data
     std::vector<ServerInfo>  servers;
     std::vector<ChannelInfo> channels;
-    std::vector<MemberInfo>  members;   // all members of selected server
-
-    // Messages – guarded by msg_mutex (written from WS thread)
-    std::mutex               msg_mutex;
-    std::vector<MessageInfo> messages;
-    bool                     scroll_to_bottom = false;
-
-    // Pending WS messages (raw JSON strings from the receive thread)
-    std::mutex              incoming_mutex;
-    std::deque<std::string> incoming_ws;
+    // Window of the selected server's member list (MEMBER_LIST): rows
+    // [members_start, members_start + members.size()) of members_total,
+    // the first members_online of which are online
+    MemberList               members;
+    int                      members_server_id = -1; // server `members` belongs to
+    int                      members_start     = 0;
+    int                      members_online    = 0;
+    int                      members_total     = 0;
+
+    // Message history per text channel – guarded by msg_mutex
+    std::mutex                            msg_mutex;
+    std::unordered_map<int, ChannelStore> channel_stores;
+    bool                                  scroll_to_bottom = false;
+    size_t                                history_cap      = 1000;  // per store
+
+    ChannelStore& store(int channel_id) { return channel_stores[channel_id]; }
+
+    // Event stream position, sent back in RESUME after a dropped connection
+    int64_t  server_epoch   = 0;
+    uint64_t last_event_seq = 0;
 
     // Voice state
     int                          voice_channel_id = -1; // -1 = not in voice
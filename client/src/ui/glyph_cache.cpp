@@ -0,0 +1,180 @@
+#include "glyph_cache.h"
+
+#include <imgui_impl_opengl3.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Dynamic codepoints kept in the atlas. At 15 px a CJK glyph takes about
+// 16×17 texels, so this bounds the atlas near 1024×1024.
+static const size_t MAX_GLYPHS = 3000;
+
+// Minimum time between re-bakes, so a burst of new text costs one bake
+static const auto BAKE_INTERVAL = std::chrono::milliseconds(250);
+
+// ─── Font files ───────────────────────────────────────────────────────────────
+
+// Candidates per role, first existing file wins: UI text, CJK, symbols.
+#ifdef _WIN32
+static const std::vector<std::vector<const char*>> FONT_CANDIDATES = {
+    { "C:\\Windows\\Fonts\\segoeui.ttf", "C:\\Windows\\Fonts\\arial.ttf" },
+    { "C:\\Windows\\Fonts\\msyh.ttc", "C:\\Windows\\Fonts\\YuGothR.ttc",
+      "C:\\Windows\\Fonts\\malgun.ttf" },
+    { "C:\\Windows\\Fonts\\seguisym.ttf", "C:\\Windows\\Fonts\\seguiemj.ttf" },
+};
+#else
+static const std::vector<std::vector<const char*>> FONT_CANDIDATES = {
+    { "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",         // Debian/Ubuntu
+      "/usr/share/fonts/dejavu-sans-fonts/DejaVuSans.ttf",       // Fedora
+      "/usr/share/fonts/TTF/DejaVuSans.ttf",                     // Arch
+      "/usr/share/fonts/truetype/noto/NotoSans-Regular.ttf" },
+    { "/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc",
+      "/usr/share/fonts/google-noto-cjk/NotoSansCJK-Regular.ttc",
+      "/usr/share/fonts/noto-cjk/NotoSansCJK-Regular.ttc",
+      "/usr/share/fonts/truetype/droid/DroidSansFallbackFull.ttf" },
+    { "/usr/share/fonts/truetype/ancient-scripts/Symbola_hint.ttf",
+      "/usr/share/fonts/gdouros-symbola/Symbola.ttf",
+      "/usr/share/fonts/truetype/noto/NotoSansSymbols2-Regular.ttf" },
+};
+#endif
+
+static bool read_file(const std::string& path, std::vector<unsigned char>& out) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    return !out.empty();
+}
+
+static std::vector<std::string> font_paths() {
+    std::vector<std::string> paths;
+    if (const char* env = getenv("NORICHAT_FONTS")) {
+        std::string list = env;
+        size_t pos = 0;
+        while (pos <= list.size()) {
+            size_t end = list.find(';', pos);
+            if (end == std::string::npos) end = list.size();
+            if (end > pos) paths.push_back(list.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        return paths;
+    }
+    for (auto& role : FONT_CANDIDATES)
+        for (const char* p : role)
+            if (std::ifstream(p, std::ios::binary)) { paths.push_back(p); break; }
+    return paths;
+}
+
+// Decode one UTF-8 sequence at `s`; returns its length (at least 1). Malformed
+// input decodes to U+FFFD.
+static int utf8_decode(const unsigned char* s, const unsigned char* end, unsigned int& cp) {
+    int len = (*s < 0x80) ? 1 : (*s >> 5) == 0x6 ? 2 : (*s >> 4) == 0xE ? 3 :
+              (*s >> 3) == 0x1E ? 4 : 0;
+    if (len == 0 || end - s < len) { cp = 0xFFFD; return 1; }
+    static const unsigned char LEAD_MASK[5] = { 0, 0x7F, 0x1F, 0x0F, 0x07 };
+    cp = s[0] & LEAD_MASK[len];
+    for (int i = 1; i < len; i++) {
+        if ((s[i] & 0xC0) != 0x80) { cp = 0xFFFD; return 1; }
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    return len;
+}
+
+// ─── GlyphCache ───────────────────────────────────────────────────────────────
+
+bool GlyphCache::init(float size_px) {
+    for (auto& path : font_paths()) {
+        std::vector<unsigned char> data;
+        if (read_file(path, data)) {
+            fprintf(stdout, "[fonts] %s\n", path.c_str());
+            fonts_.push_back(std::move(data));
+        } else {
+            fprintf(stderr, "[fonts] cannot read %s\n", path.c_str());
+        }
+    }
+    if (fonts_.empty()) {
+        fprintf(stderr, "[fonts] no font file found, using the built-in font\n");
+        return false;
+    }
+    size_px_ = size_px;
+    bake();
+    return true;
+}
+
+void GlyphCache::note(const char* text, const char* end) {
+    if (fonts_.empty() || !text) return;
+    const unsigned char* s = (const unsigned char*)text;
+    const unsigned char* e = end ? (const unsigned char*)end : s + strlen(text);
+    while (s < e) {
+        unsigned int cp;
+        s += utf8_decode(s, e, cp);
+        if (cp < 0x100) continue;                  // always baked
+#ifndef IMGUI_USE_WCHAR32
+        if (cp > 0xFFFF) continue;                 // not representable
+#endif
+        auto [it, added] = used_.try_emplace((ImWchar)cp, frame_);
+        if (!added) it->second = frame_;
+        else if (!missing_.count((ImWchar)cp)) dirty_ = true;
+    }
+}
+
+bool GlyphCache::update() {
+    frame_++;
+    if (!dirty_) return false;
+    if (std::chrono::steady_clock::now() - last_bake_ < BAKE_INTERVAL) return true;
+
+    // Least recently noted first out, but never anything noted in the frame
+    // just drawn: that would only come straight back.
+    if (used_.size() > MAX_GLYPHS) {
+        std::vector<std::pair<uint64_t, ImWchar>> by_age;
+        by_age.reserve(used_.size());
+        for (auto& [cp, frame] : used_) by_age.push_back({frame, cp});
+        size_t excess = used_.size() - MAX_GLYPHS;
+        std::nth_element(by_age.begin(), by_age.begin() + excess, by_age.end());
+        for (size_t i = 0; i < excess; i++)
+            if (by_age[i].first + 1 < frame_) used_.erase(by_age[i].second);
+    }
+
+    bake();
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    if (atlas->TexID) {                            // else the first NewFrame uploads it
+        ImGui_ImplOpenGL3_DestroyFontsTexture();
+        ImGui_ImplOpenGL3_CreateFontsTexture();
+    }
+    return true;
+}
+
+void GlyphCache::bake() {
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+
+    ImFontGlyphRangesBuilder builder;
+    builder.AddRanges(atlas->GetGlyphRangesDefault());
+    builder.AddChar(0xFFFD);
+    for (auto& [cp, frame] : used_) builder.AddChar(cp);
+    ranges_.clear();
+    builder.BuildRanges(&ranges_);
+
+    // The atlas never owns the file data: it is re-used by every bake
+    atlas->Clear();
+    ImFontConfig cfg;
+    cfg.FontDataOwnedByAtlas = false;
+    cfg.OversampleH          = 1;    // half the texels; glyphs are pixel-snapped
+    cfg.PixelSnapH           = true;
+    for (size_t i = 0; i < fonts_.size(); i++) {
+        cfg.MergeMode = (i > 0);
+        atlas->AddFontFromMemoryTTF(fonts_[i].data(), (int)fonts_[i].size(),
+                                    size_px_, &cfg, ranges_.Data);
+    }
+    atlas->Build();
+
+    // Codepoints no font has would otherwise re-trigger a bake every time
+    ImFont* font = atlas->Fonts[0];
+    for (auto& [cp, frame] : used_)
+        if (!font->FindGlyphNoFallback(cp)) missing_.insert(cp);
+
+    dirty_     = false;
+    last_bake_ = std::chrono::steady_clock::now();
+    generation_++;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <imgui.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Font atlas holding only the glyphs that text on screen needs. ImGui 1.90
+// bakes a fixed set of ranges into one texture, and baking all of Cyrillic,
+// CJK and symbols up front costs seconds and tens of MB. Instead the atlas
+// starts with Latin-1; text passed to note() records its codepoints, and
+// update() re-bakes the atlas with them between frames. Codepoints not
+// noted recently are dropped once there are more than MAX_GLYPHS.
+//
+// Glyphs come from the first font file that has them: a UI font, then CJK
+// and symbol fallbacks found in the usual system locations, or the files
+// listed in NORICHAT_FONTS (separated by ';'). UI thread only.
+class GlyphCache {
+public:
+    // Load the font files and bake the initial atlas. False if no font file
+    // was found: ImGui's default font is kept and note() does nothing.
+    bool init(float size_px);
+
+    // Record that `text` (UTF-8) is shown, or about to be.
+    void note(const char* text, const char* end = nullptr);
+    void note(const std::string& text) { note(text.data(), text.data() + text.size()); }
+
+    // Call between frames, after ImGui::Render(). Re-bakes the atlas and
+    // re-uploads its texture if noted text needs glyphs it lacks. Returns
+    // true if it changed or a change is pending, i.e. another frame is due.
+    bool update();
+
+    // Bumped on every re-bake; text measured before it may have changed width.
+    uint32_t generation() const { return generation_; }
+
+private:
+    std::vector<std::vector<unsigned char>> fonts_;   // file contents, kept for re-bakes
+    float                                   size_px_ = 0.f;
+    ImVector<ImWchar>                       ranges_;  // must outlive the atlas build
+
+    std::unordered_map<ImWchar, uint64_t> used_;      // codepoint → frame last noted
+    std::unordered_set<ImWchar>           missing_;   // in none of the fonts
+    uint64_t frame_      = 0;
+    bool     dirty_      = false;   // a noted codepoint is not baked yet
+    std::chrono::steady_clock::time_point last_bake_;
+    uint32_t generation_ = 0;
+
+    void bake();
+};
@@ -1,4 +1,5 @@
 #include "login_screen.h"
+#include "../net/bootstrap.h"
 
 #include <imgui.h>
 #include <nlohmann/json.hpp>
@@ -7,24 +8,6 @@
 
 using json = nlohmann::json;
 
-// ─── Helpers ──────────────────────────────────────────────────────────────────
-
-static void load_servers(AppState& state, HttpClient& http) {
-    auto resp = http.get("/api/servers", state.auth_token);
-    if (!resp || resp->status_code != 200) {
-        state.set_status("Failed to load servers", true);
-        return;
-    }
-    try {
-        auto arr = json::parse(resp->body);
-        state.servers.clear();
-        for (auto& o : arr)
-            state.servers.push_back({o["id"].get<int>(), o["name"].get<std::string>()});
-    } catch (...) {
-        state.set_status("Malformed server list", true);
-    }
-}
-
 // ─── LoginScreen ──────────────────────────────────────────────────────────────
 
 void LoginScreen::on_auth_success(AppState& state, HttpClient& http,
@@ -36,121 +19,39 @@ void LoginScreen::on_auth_success(AppState& state, HttpClient& http,
     state.user_id    = user_id;
     state.username   = username;
 
-    // Set up WS message → incoming queue BEFORE connecting to avoid a race
-    // between the background service thread starting and the callback being set.
-    ws.set_on_message([&state](const std::string& msg) {
-        std::lock_guard<std::mutex> lk(state.incoming_mutex);
-        state.incoming_ws.push_back(msg);
-    });
-
     // Connect WebSocket
     if (!ws.connect(state.server_host, state.server_port, token)) {
         state.set_status("Server online but WebSocket failed", true);
         return;
     }
 
-    // Load initial server list
-    load_servers(state, http);
-
-    // Select first server and load its channels + members
-    if (!state.servers.empty()) {
-        state.selected_server_id = state.servers[0].id;
-
-        // Load channels
-        auto ch_resp = http.get("/api/channels?server_id=" +
-                                std::to_string(state.selected_server_id),
-                                state.auth_token);
-        if (ch_resp && ch_resp->status_code == 200) {
-            try {
-                auto arr = json::parse(ch_resp->body);
-                state.channels.clear();
-                for (auto& o : arr)
-                    state.channels.push_back({o["id"].get<int>(),
-                                              o["server_id"].get<int>(),
-                                              o["name"].get<std::string>(),
-                                              o["type"].get<std::string>()});
-            } catch (...) {}
-        }
-
-        // Pre-select first channel; CHANNEL_JOIN is deferred to AUTH_OK in process_incoming
-        for (auto& ch : state.channels) {
-            if (ch.server_id == state.selected_server_id) {
-                state.selected_channel_id = ch.id;
-
-                // Load message history via REST (real-time will come via WS after AUTH_OK)
-                auto msg_resp = http.get("/api/messages?channel_id=" +
-                                         std::to_string(ch.id) + "&limit=50",
-                                         state.auth_token);
-                if (msg_resp && msg_resp->status_code == 200) {
-                    try {
-                        auto arr = json::parse(msg_resp->body);
-                        state.messages.clear();
-                        for (auto& o : arr) {
-                            MessageInfo m;
-                            m.id         = o.value("id", 0);
-                            m.channel_id = o.value("channel_id", 0);
-                            m.author_id  = o.value("author_id", 0);
-                            m.author     = o.value("author", "?");
-                            m.content    = o.value("content", "");
-                            m.ts         = o.value("ts", (int64_t)0);
-                            state.messages.push_back(m);
-                        }
-                        state.scroll_to_bottom = true;
-                    } catch (...) {}
-                }
-                break;
-            }
-        }
-
-        // Load server members
-        auto mem_resp = http.get("/api/members?server_id=" +
-                                  std::to_string(state.selected_server_id),
-                                  state.auth_token);
-        if (mem_resp && mem_resp->status_code == 200) {
-            try {
-                auto arr = json::parse(mem_resp->body);
-                state.members.clear();
-                for (auto& o : arr) {
-                    MemberInfo m;
-                    m.id       = o.value("id", 0);
-                    m.username = o.value("username", "?");
-                    m.online   = (m.id == state.user_id);
-                    state.members.push_back(m);
-                }
-            } catch (...) {}
-        }
-    }
-
-    state.set_status("Connected as " + username);
-    state.screen = AppState::Screen::Main;
-}
-
-void LoginScreen::do_login(AppState& state, HttpClient& http, WsClient& ws) {
-    if (busy_) return;
-    std::string uname(username_buf_);
-    std::string passwd(password_buf_);
-    if (uname.empty() || passwd.empty()) {
-        state.set_status("Enter username and password", true);
-        return;
-    }
-
+    // Servers, channels and history of the first channel in one
+    // round trip; CHANNEL_JOIN is deferred to AUTH_OK in process_incoming
     busy_ = true;
-    json body;
-    body["username"] = uname;
-    body["password"] = passwd;
-
-    auto resp = http.post("/api/login", body.dump());
-    busy_ = false;
+    load_bootstrap(state, http, -1, [this, &state, username](bool ok) {
+        busy_ = false;
+        if (ok)
+            state.set_status("Connected as " + username);
+        else
+            state.set_status("Failed to load servers", true);
+        state.screen = AppState::Screen::Main;
+    });
+}
 
+void LoginScreen::on_auth_response(AppState& state, HttpClient& http,
+                                   WsClient& ws,
+                                   const std::optional<HttpResponse>& resp,
+                                   int expected_status,
+                                   const char* fail_msg) {
     if (!resp) {
         state.set_status("Cannot reach server", true);
         return;
     }
-    if (resp->status_code != 200) {
+    if (resp->status_code != expected_status) {
         try {
             auto err = json::parse(resp->body);
-            state.set_status(err.value("error", "Login failed"), true);
-        } catch (...) { state.set_status("Login failed", true); }
+            state.set_status(err.value("error", fail_msg), true);
+        } catch (...) { state.set_status(fail_msg, true); }
         return;
     }
     try {
@@ -164,7 +65,7 @@ void LoginScreen::do_login(AppState& state, HttpClient& http, WsClient& ws) {
     }
 }
 
-void LoginScreen::do_register(AppState& state, HttpClient& http, WsClient& ws) {
+void LoginScreen::do_login(AppState& state, HttpClient& http, WsClient& ws) {
     if (busy_) return;
     std::string uname(username_buf_);
     std::string passwd(password_buf_);
@@ -178,29 +79,36 @@ void LoginScreen::do_register(AppState& state, HttpClient& http, WsClient& ws) {
     body["username"] = uname;
     body["password"] = passwd;
 
-    auto resp = http.post("/api/register", body.dump());
-    busy_ = false;
+    state.set_status("Connecting...");
+    http.set_endpoint(state.server_host, state.server_port);
+    http.post("/api/login", body.dump(), "",
+              [this, &state, &http, &ws](std::optional<HttpResponse> resp) {
+        busy_ = false;
+        on_auth_response(state, http, ws, resp, 200, "Login failed");
+    });
+}
 
-    if (!resp) {
-        state.set_status("Cannot reach server", true);
-        return;
-    }
-    if (resp->status_code != 201) {
-        try {
-            auto err = json::parse(resp->body);
-            state.set_status(err.value("error", "Register failed"), true);
-        } catch (...) { state.set_status("Register failed", true); }
+void LoginScreen::do_register(AppState& state, HttpClient& http, WsClient& ws) {
+    if (busy_) return;
+    std::string uname(username_buf_);
+    std::string passwd(password_buf_);
+    if (uname.empty() || passwd.empty()) {
+        state.set_status("Enter username and password", true);
         return;
     }
-    try {
-        auto j = json::parse(resp->body);
-        on_auth_success(state, http, ws,
-                        j["token"].get<std::string>(),
-                        j["user_id"].get<int>(),
-                        j["username"].get<std::string>());
-    } catch (...) {
-        state.set_status("Malformed response", true);
-    }
+
+    busy_ = true;
+    json body;
+    body["username"] = uname;
+    body["password"] = passwd;
+
+    state.set_status("Connecting...");
+    http.set_endpoint(state.server_host, state.server_port);
+    http.post("/api/register", body.dump(), "",
+              [this, &state, &http, &ws](std::optional<HttpResponse> resp) {
+        busy_ = false;
+        on_auth_response(state, http, ws, resp, 201, "Register failed");
+    });
 }
 
 void LoginScreen::render(AppState& state, HttpClient& http, WsClient& ws) {
@@ -16,6 +16,9 @@ private:
 
     void do_login(AppState& state, HttpClient& http, WsClient& ws);
     void do_register(AppState& state, HttpClient& http, WsClient& ws);
+    void on_auth_response(AppState& state, HttpClient& http, WsClient& ws,
+                          const std::optional<HttpResponse>& resp,
+                          int expected_status, const char* fail_msg);
     void on_auth_success(AppState& state, HttpClient& http,
                          WsClient& ws, const std::string& token,
                          int user_id, const std::string& username);
@@ -1,4 +1,5 @@
 #include "main_screen.h"
+#include "../net/bootstrap.h"
 
 #include <imgui.h>
 #include <nlohmann/json.hpp>
@@ -6,10 +7,20 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <iterator>
 #include <string>
 
 using json = nlohmann::json;
 
+// Messages per /api/messages request (initial load and each scroll-back page)
+static const int HISTORY_PAGE = 50;
+
+// Member-list window: rows fetched beyond each visible edge, minimum and
+// maximum (the server's cap) rows per MEMBER_LIST_SUBSCRIBE
+static const int MEMBER_MARGIN     = 25;
+static const int MEMBER_WINDOW     = 100;
+static const int MEMBER_WINDOW_MAX = 200;
+
 // ─── Helpers ──────────────────────────────────────────────────────────────────
 
 static std::string format_ts(int64_t ts) {
@@ -27,128 +38,121 @@ static std::string format_ts(int64_t ts) {
 
 // ─── Incoming WS message processing ──────────────────────────────────────────
 
-void MainScreen::process_incoming(AppState& state, WsClient& ws, VoiceClient& voice) {
-    std::deque<std::string> queue;
-    {
-        std::lock_guard<std::mutex> lk(state.incoming_mutex);
-        queue.swap(state.incoming_ws);
-    }
+void MainScreen::process_incoming(AppState& state, WsClient& ws) {
+    bool    any = false;
+    WsEvent ev;
+    while (ws.poll_event(ev)) {
+        any = true;
+        state.last_event_seq = std::max(state.last_event_seq, ev.seq);
 
-    for (auto& raw : queue) {
-        json msg;
-        try { msg = json::parse(raw); }
-        catch (...) { continue; }
-
-        std::string op = msg.value("op", "");
-
-        if (op == "AUTH_OK") {
-            if (msg.contains("online") && msg["online"].is_array()) {
-                for (auto& u : msg["online"]) {
-                    int uid = u.value("user_id", 0);
-                    std::string uname = u.value("username", "");
-                    bool found = false;
-                    for (auto& m : state.members) {
-                        if (m.id == uid) { m.online = true; found = true; break; }
-                    }
-                    if (!found && uid > 0)
-                        state.members.push_back({uid, uname, true});
-                }
-            }
-            for (auto& m : state.members)
-                if (m.id == state.user_id) { m.online = true; break; }
-
-            if (state.selected_channel_id >= 0) {
-                json join;
-                join["op"]         = "CHANNEL_JOIN";
-                join["channel_id"] = state.selected_channel_id;
-                ws.send(join.dump());
-            }
+        if (auto* e = std::get_if<AuthOkEvent>(&ev.body)) {
+            state.server_epoch = e->epoch;
+            member_sub_server_ = -1;   // new session: render_members resubscribes
+
+            send_text_channels(state, ws, "CHANNEL_JOIN");
             state.set_status("WebSocket authenticated");
         }
-        else if (op == "USER_ONLINE") {
-            int uid = msg.value("user_id", 0);
-            std::string uname = msg.value("username", "");
-            bool found = false;
-            for (auto& m : state.members) {
-                if (m.id == uid) { m.online = true; found = true; break; }
+        else if (auto* e = std::get_if<ResumedEvent>(&ev.body)) {
+            // Missed channel events follow this message; presence comes with
+            // a fresh member-list window, and history is refetched only for
+            // channels listed in "reload".
+            state.server_epoch = e->epoch;
+            member_sub_server_ = -1;
+
+            std::lock_guard<std::mutex> lk(state.msg_mutex);
+            for (int ch_id : e->reload) {
+                if (ch_id == state.selected_channel_id) {
+                    reload_messages_ = true;
+                } else if (auto it = state.channel_stores.find(ch_id);
+                           it != state.channel_stores.end()) {
+                    // Gap in a background channel: refetch when selected
+                    it->second.assign({});
+                    it->second.loaded = false;
+                }
             }
-            if (!found && uid > 0)
-                state.members.push_back({uid, uname, true});
+            state.set_status("Reconnected");
         }
-        else if (op == "USER_OFFLINE") {
-            int uid = msg.value("user_id", 0);
-            for (auto& m : state.members)
-                if (m.id == uid) { m.online = false; break; }
-            state.voice_participants.erase(
-                std::remove_if(state.voice_participants.begin(),
-                               state.voice_participants.end(),
-                               [uid](const VoiceParticipant& p){ return p.user_id == uid; }),
-                state.voice_participants.end());
+        else if (auto* e = std::get_if<MemberListEvent>(&ev.body)) {
+            if (e->server_id != state.selected_server_id) continue;  // switched meanwhile
+            state.members.assign(e->members);
+            state.members_server_id = e->server_id;
+            state.members_start     = e->start;
+            state.members_online    = e->online_count;
+            state.members_total     = e->total;
         }
-        else if (op == "MESSAGE_NEW") {
-            MessageInfo m;
-            m.id         = msg.value("id", 0);
-            m.channel_id = msg.value("channel_id", 0);
-            m.author_id  = msg.value("author_id", 0);
-            m.author     = msg.value("author", "?");
-            m.content    = msg.value("content", "");
-            m.ts         = msg.value("ts", (int64_t)0);
-
-            if (m.channel_id == state.selected_channel_id) {
-                std::lock_guard<std::mutex> lk(state.msg_mutex);
-                state.messages.push_back(m);
-                state.scroll_to_bottom = true;
+        else if (auto* e = std::get_if<MessageNewEvent>(&ev.body)) {
+            MessageInfo& m  = e->msg;
+            bool selected   = (m.channel_id == state.selected_channel_id);
+            bool own        = (m.author_id == state.user_id);
+            std::lock_guard<std::mutex> lk(state.msg_mutex);
+            ChannelStore& st = state.store(m.channel_id);
+            if (!selected && !own) st.unread++;
+            if (st.has_newer) {
+                // The newest pages are not loaded; paging down fetches
+                // this, unless it raced the last page request.
+                st.live_tail.push_back(m);
+                if (st.live_tail.size() > (size_t)HISTORY_PAGE)
+                    st.live_tail.erase(st.live_tail.begin());
+                if (selected && own)
+                    reload_messages_ = true;   // jump to own message
+            } else {
+                // Cache it only if it extends the cached run of the channel
+                if (cache_.is_open() && st.loaded &&
+                    (st.messages.empty() ? cache_.newest_id(m.channel_id) == 0
+                                         : cache_.has(st.messages.back().id)))
+                    cache_.store(m);
+                st.append(std::move(m));
+                bool evicted = st.trim(state.history_cap, true);
+                if (selected) {
+                    if (at_bottom_ || own) state.scroll_to_bottom = true;
+                    if (evicted)           restore_anchor_        = true;
+                }
             }
         }
-        else if (op == "MESSAGE_EDITED") {
-            int msg_id       = msg.value("message_id", 0);
-            int ch_id        = msg.value("channel_id", 0);
-            std::string cont = msg.value("content", "");
-            if (ch_id == state.selected_channel_id) {
-                std::lock_guard<std::mutex> lk(state.msg_mutex);
-                for (auto& m : state.messages)
-                    if (m.id == msg_id) { m.content = cont; break; }
-            }
+        else if (auto* e = std::get_if<MessageEditedEvent>(&ev.body)) {
+            int                msg_id = e->message_id;
+            int                ch_id  = e->channel_id;
+            const std::string& cont   = e->content;
+            cache_.update_content(msg_id, cont);
+
+            std::lock_guard<std::mutex> lk(state.msg_mutex);
+            auto it = state.channel_stores.find(ch_id);
+            if (it != state.channel_stores.end())
+                if (MessageInfo* m = it->second.find(msg_id)) {
+                    m->content  = cont;
+                    m->layout_w = 0.f;
+                    if (ch_id == state.selected_channel_id) restore_anchor_ = true;
+                }
         }
-        else if (op == "MESSAGE_DELETED") {
-            int msg_id = msg.value("message_id", 0);
-            int ch_id  = msg.value("channel_id", 0);
-            if (ch_id == state.selected_channel_id) {
-                std::lock_guard<std::mutex> lk(state.msg_mutex);
-                auto& msgs = state.messages;
-                msgs.erase(
-                    std::remove_if(msgs.begin(), msgs.end(),
-                        [msg_id](const MessageInfo& m){ return m.id == msg_id; }),
-                    msgs.end());
-            }
+        else if (auto* e = std::get_if<MessageDeletedEvent>(&ev.body)) {
+            int msg_id = e->message_id;
+            int ch_id  = e->channel_id;
+            cache_.remove(msg_id);
+
+            std::lock_guard<std::mutex> lk(state.msg_mutex);
+            auto it = state.channel_stores.find(ch_id);
+            if (it != state.channel_stores.end() && it->second.erase(msg_id) &&
+                ch_id == state.selected_channel_id)
+                restore_anchor_ = true;
         }
         // ── Voice events ──────────────────────────────────────────────────────
-        else if (op == "VOICE_JOIN_OK") {
-            state.voice_channel_id = msg.value("channel_id", -1);
-            state.voice_participants.clear();
-            if (msg.contains("participants") && msg["participants"].is_array()) {
-                for (auto& p : msg["participants"])
-                    state.voice_participants.push_back(
-                        {p.value("user_id", 0), p.value("username", "?")});
-            }
+        else if (auto* e = std::get_if<VoiceJoinOkEvent>(&ev.body)) {
+            state.voice_channel_id   = e->channel_id;
+            state.voice_participants = std::move(e->participants);
             state.set_status("Joined voice channel");
         }
-        else if (op == "VOICE_JOINED") {
-            int ch_id = msg.value("channel_id", -1);
-            if (ch_id == state.voice_channel_id) {
-                int uid = msg.value("user_id", 0);
+        else if (auto* e = std::get_if<VoiceJoinedEvent>(&ev.body)) {
+            if (e->channel_id == state.voice_channel_id) {
                 bool found = false;
                 for (auto& p : state.voice_participants)
-                    if (p.user_id == uid) { found = true; break; }
+                    if (p.user_id == e->user_id) { found = true; break; }
                 if (!found)
-                    state.voice_participants.push_back(
-                        {uid, msg.value("username", "?")});
+                    state.voice_participants.push_back({e->user_id, e->username});
             }
         }
-        else if (op == "VOICE_LEFT") {
-            int ch_id = msg.value("channel_id", -1);
-            int uid   = msg.value("user_id", 0);
-            if (ch_id == state.voice_channel_id) {
+        else if (auto* e = std::get_if<VoiceLeftEvent>(&ev.body)) {
+            int uid = e->user_id;
+            if (e->channel_id == state.voice_channel_id) {
                 state.voice_participants.erase(
                     std::remove_if(state.voice_participants.begin(),
                                    state.voice_participants.end(),
@@ -156,58 +160,267 @@ void MainScreen::process_incoming(AppState& state, WsClient& ws, VoiceClient& vo
                     state.voice_participants.end());
             }
         }
-        else if (op == "VOICE_DATA") {
-            std::string b64 = msg.value("data", "");
-            if (!b64.empty() && voice.is_active())
-                voice.play_frame(b64);
-        }
-        else if (op == "AUTH_FAIL" || op == "ERROR") {
-            state.set_status(msg.value("error", "Server error"), true);
+        else if (auto* e = std::get_if<ErrorEvent>(&ev.body)) {
+            state.set_status(e->error, true);
         }
     }
+    if (any) sync_resume(state, ws);
+}
+
+// ─── Reconnect ────────────────────────────────────────────────────────────────
+
+// WsClient reconnects by itself and resumes from the point given here: the
+// server replays the events we missed on these channels, so history is not
+// refetched over HTTP.
+void MainScreen::sync_resume(AppState& state, WsClient& ws) {
+    std::vector<int> channels;
+    for (auto& ch : state.channels)
+        if (ch.type == "text") channels.push_back(ch.id);
+    ws.set_resume(state.server_epoch, state.last_event_seq, std::move(channels));
 }
 
 // ─── Data loading ─────────────────────────────────────────────────────────────
 
-void MainScreen::load_members(AppState& state, HttpClient& http, int server_id) {
-    auto resp = http.get("/api/members?server_id=" + std::to_string(server_id),
-                         state.auth_token);
-    if (!resp || resp->status_code != 200) return;
-
-    try {
-        auto arr = json::parse(resp->body);
-        state.members.clear();
-        for (auto& o : arr) {
-            MemberInfo m;
-            m.id       = o.value("id", 0);
-            m.username = o.value("username", "?");
-            m.online   = (m.id == state.user_id);
-            state.members.push_back(m);
-        }
-    } catch (...) {}
+// Make `channel_id` the selected text channel. A store that is already
+// loaded is shown as it is, at the position it was left; only a channel
+// opened for the first time loads history.
+void MainScreen::select_channel(AppState& state, HttpClient& http, int channel_id) {
+    std::lock_guard<std::mutex> lk(state.msg_mutex);
+    auto cur = state.channel_stores.find(state.selected_channel_id);
+    if (cur != state.channel_stores.end()) {
+        cur->second.anchor_id    = anchor_id_;
+        cur->second.anchor_delta = anchor_delta_;
+        cur->second.at_bottom    = at_bottom_;
+    }
+
+    state.selected_channel_id = channel_id;
+    editing_msg_id_           = -1;
+    ChannelStore& st = state.store(channel_id);
+    st.unread = 0;
+    if (!st.loaded) {
+        at_bottom_ = true;
+        load_messages(state, http, channel_id);
+    } else if (st.at_bottom) {
+        at_bottom_             = true;
+        state.scroll_to_bottom = true;
+    } else {
+        at_bottom_      = false;
+        anchor_id_      = st.anchor_id;
+        anchor_delta_   = st.anchor_delta;
+        restore_anchor_ = true;
+    }
 }
 
+// Show the cached history of `channel_id` right away, then fetch only what
+// is newer than it (or the newest page when nothing is cached). Live
+// messages already in the store are kept after the cached ones.
+// Caller holds msg_mutex.
 void MainScreen::load_messages(AppState& state, HttpClient& http, int channel_id) {
-    auto resp = http.get("/api/messages?channel_id=" + std::to_string(channel_id) +
-                         "&limit=50", state.auth_token);
+    std::vector<MessageInfo> msgs;
+    if (cache_.is_open()) msgs = cache_.load(channel_id, HISTORY_PAGE);
+    int newest = msgs.empty() ? 0 : msgs.back().id;
+
+    // Deleted messages leave holes in the cache, so even a short cached run
+    // may have history before it; the first older page that comes back short
+    // settles it. Live messages don't count.
+    ChannelStore& st = state.store(channel_id);
+    st.has_older = !msgs.empty();
+    for (auto& m : st.messages)
+        if (m.id > newest) msgs.push_back(std::move(m));
+    st.has_newer = false;
+    st.loaded    = true;
+    st.live_tail.clear();
+    st.assign(std::move(msgs));
+    if (channel_id == state.selected_channel_id) state.scroll_to_bottom = true;
+
+    if (newest > 0)
+        fetch_delta(state, http, channel_id, newest);
+    else
+        fetch_newest(state, http, channel_id);
+}
+
+// Replace the store with the newest page of the channel.
+void MainScreen::fetch_newest(AppState& state, HttpClient& http, int channel_id) {
+    http.get("/api/messages?channel_id=" + std::to_string(channel_id) +
+             "&limit=" + std::to_string(HISTORY_PAGE), state.auth_token,
+             [this, &state, channel_id](std::optional<HttpResponse> resp) {
+        if (!resp || resp->status_code != 200) return;
+
+        std::vector<MessageInfo> loaded;
+        try {
+            for (auto& o : json::parse(resp->body))
+                loaded.push_back(parse_message(o));
+        } catch (...) { return; }
+
+        std::lock_guard<std::mutex> lk(state.msg_mutex);
+        auto it = state.channel_stores.find(channel_id);
+        if (it == state.channel_stores.end()) return;   // server switched meanwhile
+        ChannelStore& st = it->second;
+        cache_newest(channel_id, loaded);
+
+        // MESSAGE_NEW events that arrived while the request was in flight
+        // are newer than the history; keep them after it.
+        st.has_older = loaded.size() >= (size_t)HISTORY_PAGE;
+        st.has_newer = false;
+        int last_id = loaded.empty() ? 0 : loaded.back().id;
+        for (auto& m : st.messages)
+            if (m.id > last_id) loaded.push_back(std::move(m));
+        st.assign(std::move(loaded));
+        if (channel_id == state.selected_channel_id) state.scroll_to_bottom = true;
+    });
+}
+
+// Append the messages after `after_id` (the newest cached one). If there is
+// more than a page of them the cache is too far behind: reload from the top.
+void MainScreen::fetch_delta(AppState& state, HttpClient& http, int channel_id,
+                             int after_id) {
+    http.get("/api/messages?channel_id=" + std::to_string(channel_id) +
+             "&limit=" + std::to_string(HISTORY_PAGE) +
+             "&after=" + std::to_string(after_id), state.auth_token,
+             [this, &state, &http, channel_id, after_id](std::optional<HttpResponse> resp) {
+        if (!resp || resp->status_code != 200) return;   // keep showing the cache
+
+        std::vector<MessageInfo> page;
+        try {
+            for (auto& o : json::parse(resp->body))
+                page.push_back(parse_message(o));
+        } catch (...) { return; }
+
+        std::lock_guard<std::mutex> lk(state.msg_mutex);
+        auto it = state.channel_stores.find(channel_id);
+        if (it == state.channel_stores.end()) return;
+        if (page.size() >= (size_t)HISTORY_PAGE) {
+            fetch_newest(state, http, channel_id);
+            return;
+        }
+        if (cache_.is_open()) cache_.store(page);
+
+        // Live messages after after_id may already be in the store; the page
+        // supersedes those it contains.
+        ChannelStore& st      = it->second;
+        int           last_id = page.empty() ? after_id : page.back().id;
+        std::vector<MessageInfo> msgs;
+        for (auto& m : st.messages)
+            if (m.id <= after_id) msgs.push_back(std::move(m));
+        std::vector<MessageInfo> live;
+        for (auto& m : st.messages)
+            if (m.id > last_id) live.push_back(std::move(m));
+        st.assign(std::move(msgs));
+        st.append(std::move(page));
+        st.append(std::move(live));
+        st.trim(state.history_cap, true);
+        if (channel_id == state.selected_channel_id) state.scroll_to_bottom = true;
+    });
+}
+
+// Fetch the page before the first (older) or after the last message of the
+// selected channel, merge it in and evict from the far end beyond
+// history_cap. Older pages come from the cache when it holds a full one.
+void MainScreen::load_history_page(AppState& state, HttpClient& http, bool older) {
+    int channel_id = state.selected_channel_id;
+    int cursor;
+    {
+        std::lock_guard<std::mutex> lk(state.msg_mutex);
+        ChannelStore& st = state.store(channel_id);
+        if (st.messages.empty()) return;
+        cursor = older ? st.messages.front().id : st.messages.back().id;
+    }
+
+    if (older && cache_.is_open() && cache_.has(cursor)) {
+        auto page = cache_.load(channel_id, HISTORY_PAGE, cursor);
+        if (page.size() == (size_t)HISTORY_PAGE) {
+            merge_history_page(state, channel_id, cursor, older, std::move(page));
+            return;
+        }
+    }
+
+    history_loading_ = true;
+    http.get("/api/messages?channel_id=" + std::to_string(channel_id) +
+             "&limit=" + std::to_string(HISTORY_PAGE) +
+             (older ? "&before=" : "&after=") + std::to_string(cursor),
+             state.auth_token,
+             [this, &state, channel_id, cursor, older](std::optional<HttpResponse> resp) {
+        history_loading_ = false;
+        if (!resp || resp->status_code != 200) return;
+
+        std::vector<MessageInfo> page;
+        try {
+            for (auto& o : json::parse(resp->body))
+                page.push_back(parse_message(o));
+        } catch (...) { return; }
+
+        // Adjacent to the cursor, so it extends the cached run if that
+        // contains the cursor
+        if (cache_.is_open() && cache_.has(cursor)) cache_.store(page);
+        merge_history_page(state, channel_id, cursor, older, std::move(page));
+    });
+}
+
+void MainScreen::merge_history_page(AppState& state, int channel_id, int cursor,
+                                    bool older, std::vector<MessageInfo> page) {
     std::lock_guard<std::mutex> lk(state.msg_mutex);
-    state.messages.clear();
-    if (!resp || resp->status_code != 200) return;
-
-    try {
-        auto arr = json::parse(resp->body);
-        for (auto& o : arr) {
-            MessageInfo m;
-            m.id         = o.value("id", 0);
-            m.channel_id = o.value("channel_id", 0);
-            m.author_id  = o.value("author_id", 0);
-            m.author     = o.value("author", "?");
-            m.content    = o.value("content", "");
-            m.ts         = o.value("ts", (int64_t)0);
-            state.messages.push_back(m);
+    auto it = state.channel_stores.find(channel_id);
+    if (it == state.channel_stores.end() || it->second.messages.empty()) return;
+    ChannelStore& st = it->second;
+    // Drop the page if the store was reloaded while it was in flight
+    if ((older ? st.messages.front().id : st.messages.back().id) != cursor) return;
+
+    bool last_page = page.size() < (size_t)HISTORY_PAGE;
+    if (older) {
+        st.has_older = !last_page;
+        st.prepend(std::move(page));
+    } else {
+        st.append(std::move(page));
+        if (last_page) {
+            // Caught up: add live messages the page did not include
+            st.has_newer = false;
+            std::vector<MessageInfo> live;
+            for (auto& m : st.live_tail)
+                if (m.id > st.messages.back().id) live.push_back(std::move(m));
+            st.live_tail.clear();
+            st.append(std::move(live));
         }
-    } catch (...) {}
-    state.scroll_to_bottom = true;
+    }
+    st.trim(state.history_cap, !older);
+    if (channel_id == state.selected_channel_id) restore_anchor_ = true;
+}
+
+// (Un)subscribe every text channel of the selected server, so events of
+// background channels land in their stores too.
+void MainScreen::send_text_channels(AppState& state, WsClient& ws, const char* op) {
+    for (auto& ch : state.channels) {
+        if (ch.type != "text") continue;
+        json j;
+        j["op"]         = op;
+        j["channel_id"] = ch.id;
+        ws.send(j.dump());
+    }
+    sync_resume(state, ws);
+}
+
+// ─── Message cache ────────────────────────────────────────────────────────────
+
+void MainScreen::open_cache(AppState& state) {
+    cache_tried_ = true;
+    if (state.data_dir.empty()) return;
+    if (!cache_.open(state.data_dir +
+                     message_cache_file(state.server_host, state.server_port,
+                                        state.user_id)))
+        return;
+
+    // History that came with the bootstrap response
+    std::lock_guard<std::mutex> lk(state.msg_mutex);
+    cache_newest(state.selected_channel_id, state.store(state.selected_channel_id).messages);
+}
+
+// Store a newest page. It extends the cached run if it reaches back into it
+// or is the whole channel (short page); otherwise the run is stale and is
+// replaced.
+void MainScreen::cache_newest(int channel_id, const std::vector<MessageInfo>& page) {
+    if (!cache_.is_open() || page.empty()) return;
+    if (page.size() >= (size_t)HISTORY_PAGE && !cache_.has(page.front().id))
+        cache_.clear_channel(channel_id);
+    cache_.store(page);
 }
 
 // ─── Sidebar (servers + channels) ────────────────────────────────────────────
@@ -227,6 +440,7 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
                  ImGuiWindowFlags_NoMove      |
                  ImGuiWindowFlags_NoScrollbar);
 
+    glyphs_.note(state.username);
     ImGui::TextColored(ImVec4(0.0f, 0.85f, 1.0f, 1.f), "  %s", state.username.c_str());
     if (voice.is_active()) {
         ImGui::SameLine();
@@ -235,6 +449,7 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
     ImGui::Separator();
     ImGui::Spacing();
 
+    int switch_to_server = -1;   // applied after the loop: it replaces state.servers
     for (auto& sv : state.servers) {
         bool is_selected_server = (sv.id == state.selected_server_id);
         ImGui::PushStyleColor(ImGuiCol_Header,
@@ -242,6 +457,7 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
                               ? ImVec4(0.8f, 0.4f, 0.0f, 0.5f)
                               : ImVec4(0, 0, 0, 0));
 
+        glyphs_.note(sv.name);
         bool open = ImGui::CollapsingHeader(sv.name.c_str(),
                                             ImGuiTreeNodeFlags_DefaultOpen);
         ImGui::PopStyleColor();
@@ -249,6 +465,7 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
         if (open) {
             for (auto& ch : state.channels) {
                 if (ch.server_id != sv.id) continue;
+                glyphs_.note(ch.name);
 
                 bool is_voice      = (ch.type == "voice");
                 bool in_this_voice = is_voice && (ch.id == state.voice_channel_id);
@@ -258,6 +475,13 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
                 std::string label = is_voice
                     ? ("  > " + ch.name)
                     : ("  # " + ch.name);
+                if (!is_voice) {
+                    std::lock_guard<std::mutex> lk(state.msg_mutex);
+                    auto it = state.channel_stores.find(ch.id);
+                    if (it != state.channel_stores.end() && it->second.unread > 0)
+                        label += "  (" + std::to_string(it->second.unread) + ")";
+                }
+                label += "##ch" + std::to_string(ch.id);
 
                 if (is_voice)
                     ImGui::PushStyleColor(ImGuiCol_Text,
@@ -303,21 +527,8 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
                         }
                     } else {
                         // Text channel
-                        if (!sel) {
-                            if (state.selected_channel_id >= 0) {
-                                json leave;
-                                leave["op"]         = "CHANNEL_LEAVE";
-                                leave["channel_id"] = state.selected_channel_id;
-                                ws.send(leave.dump());
-                            }
-                            state.selected_channel_id = ch.id;
-                            json join;
-                            join["op"]         = "CHANNEL_JOIN";
-                            join["channel_id"] = ch.id;
-                            ws.send(join.dump());
-                            load_messages(state, http, ch.id);
-                            editing_msg_id_ = -1;
-                        }
+                        // Already subscribed: only the view changes
+                        if (!sel) select_channel(state, http, ch.id);
                     }
                 }
 
@@ -326,26 +537,8 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
             }
         }
 
-        if (ImGui::IsItemClicked() && sv.id != state.selected_server_id) {
-            state.selected_server_id  = sv.id;
-            state.selected_channel_id = -1;
-            state.messages.clear();
-            editing_msg_id_ = -1;
-
-            auto resp = http.get("/api/channels?server_id=" +
-                                 std::to_string(sv.id), state.auth_token);
-            state.channels.clear();
-            if (resp && resp->status_code == 200) {
-                try {
-                    auto arr = json::parse(resp->body);
-                    for (auto& o : arr)
-                        state.channels.push_back({o["id"].get<int>(),
-                                                  o["server_id"].get<int>(),
-                                                  o["name"].get<std::string>(),
-                                                  o["type"].get<std::string>()});
-                } catch (...) {}
-            }
-        }
+        if (ImGui::IsItemClicked() && sv.id != state.selected_server_id)
+            switch_to_server = sv.id;
 
         // "+" button to create a new channel
         if (open) {
@@ -366,6 +559,25 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
         }
     }
 
+    if (switch_to_server >= 0) {
+        send_text_channels(state, ws, "CHANNEL_LEAVE");
+        editing_msg_id_ = -1;
+        load_bootstrap(state, http, switch_to_server, [this, &state, &ws](bool ok) {
+            if (!ok) {
+                state.set_status("Failed to load server", true);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lk(state.msg_mutex);
+                cache_newest(state.selected_channel_id,
+                             state.store(state.selected_channel_id).messages);
+            }
+            at_bottom_         = true;
+            member_sub_server_ = -1;
+            send_text_channels(state, ws, "CHANNEL_JOIN");
+        });
+    }
+
     // ── Create Channel modal ─────────────────────────────────────────────────
     ImGui::SetNextWindowSize(ImVec2(320.f, 175.f), ImGuiCond_Always);
     ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f),
@@ -399,12 +611,24 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
             body["server_id"] = create_channel_server_id_;
             body["name"]      = std::string(new_channel_buf_);
             body["type"]      = new_channel_is_voice_ ? "voice" : "text";
-            auto resp = http.post("/api/channels", body.dump(), state.auth_token);
-            if (resp && resp->status_code == 201) {
-                auto ch_resp = http.get("/api/channels?server_id=" +
-                                        std::to_string(create_channel_server_id_),
-                                        state.auth_token);
-                if (ch_resp && ch_resp->status_code == 200) {
+            int server_id = create_channel_server_id_;
+            http.post("/api/channels", body.dump(), state.auth_token,
+                      [this, &state, &http, &ws, server_id](std::optional<HttpResponse> resp) {
+                if (!resp || resp->status_code != 201) {
+                    try {
+                        auto err = json::parse(resp ? resp->body : "{}");
+                        state.set_status(err.value("error", "Failed to create channel"), true);
+                    } catch (...) {
+                        state.set_status("Failed to create channel", true);
+                    }
+                    return;
+                }
+                state.set_status("Channel created");
+                http.get("/api/channels?server_id=" + std::to_string(server_id),
+                         state.auth_token,
+                         [this, &state, &ws, server_id](std::optional<HttpResponse> ch_resp) {
+                    if (!ch_resp || ch_resp->status_code != 200) return;
+                    if (state.selected_server_id != server_id) return;
                     try {
                         auto arr = json::parse(ch_resp->body);
                         state.channels.clear();
@@ -414,16 +638,10 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
                                                       o["name"].get<std::string>(),
                                                       o["type"].get<std::string>()});
                     } catch (...) {}
-                }
-                state.set_status("Channel created");
-            } else {
-                try {
-                    auto err = json::parse(resp ? resp->body : "{}");
-                    state.set_status(err.value("error", "Failed to create channel"), true);
-                } catch (...) {
-                    state.set_status("Failed to create channel", true);
-                }
-            }
+                    // Subscribe the new channel (JOIN is idempotent)
+                    send_text_channels(state, ws, "CHANNEL_JOIN");
+                });
+            });
             show_create_channel_ = false;
             ImGui::CloseCurrentPopup();
         }
@@ -435,7 +653,7 @@ void MainScreen::render_sidebar(AppState& state, HttpClient& http,
 
 // ─── Message list ─────────────────────────────────────────────────────────────
 
-void MainScreen::render_messages(AppState& state, WsClient& ws) {
+void MainScreen::render_messages(AppState& state, HttpClient& http, WsClient& ws) {
     ImGuiIO& io = ImGui::GetIO();
     const float sidebar_w  = 220.f;
     const float members_w  = 160.f;
@@ -479,19 +697,74 @@ void MainScreen::render_messages(AppState& state, WsClient& ws) {
     int         pending_delete     = -1;
     int         pending_edit_id    = -1;
     std::string pending_edit_cont;
+    int         page_request       = 0;    // -1 older, +1 newer
 
     if (state.selected_channel_id < 0) {
         ImGui::TextDisabled("Select a channel to start chatting.");
     } else {
         std::lock_guard<std::mutex> lk(state.msg_mutex);
+        ChannelStore& st   = state.store(state.selected_channel_id);
+        auto&         msgs = st.messages;
+
+        // Only rows overlapping the viewport are submitted. ImGuiListClipper
+        // needs uniform heights, so rows are placed from prefix sums of the
+        // cached wrapped-text heights instead.
+        const float   width  = ImGui::GetContentRegionAvail().x;
+        const float   base_y = ImGui::GetCursorPosY();
+        const int64_t now    = (int64_t)time(nullptr);
+
+        row_offsets_.resize(msgs.size() + 1);
+        row_offsets_[0] = 0.f;
+        for (size_t i = 0; i < msgs.size(); i++)
+            row_offsets_[i + 1] = row_offsets_[i] + message_height(msgs[i], width);
+
+        // Put the anchor row back where it was after rows above it changed.
+        // The new scroll position only applies next frame, so this frame the
+        // rows are drawn shifted to where they will land.
+        float scroll_y = ImGui::GetScrollY();
+        if (restore_anchor_ && !state.scroll_to_bottom) {
+            int64_t pos = st.position(anchor_id_);
+            if (pos >= 0) {
+                scroll_y = base_y + row_offsets_[(size_t)pos] + anchor_delta_;
+                ImGui::SetScrollY(scroll_y);
+            }
+        }
+        restore_anchor_ = false;
+        const float shift = scroll_y - ImGui::GetScrollY();
+
+        const float view_h   = ImGui::GetWindowHeight();
+        const float view_top = scroll_y - base_y;
+        const float view_bot = view_top + view_h;
+        size_t first = std::upper_bound(row_offsets_.begin(), row_offsets_.end() - 1,
+                                        view_top) - row_offsets_.begin();
+        if (first > 0) first--;
+        if (first < msgs.size()) {
+            anchor_id_    = msgs[first].id;
+            anchor_delta_ = view_top - row_offsets_[first];
+        }
+
+        // Glyphs are wanted for the rows drawn plus a screen either side, so
+        // they are baked before being scrolled to. Only these rows: noting
+        // the whole store could exceed the atlas and re-bake forever.
+        size_t ahead = std::upper_bound(row_offsets_.begin(), row_offsets_.end() - 1,
+                                        view_top - view_h) - row_offsets_.begin();
+        if (ahead > 0) ahead--;
+        for (size_t i = ahead; i < msgs.size() && row_offsets_[i] < view_bot + view_h; i++) {
+            glyphs_.note(msgs[i].author);
+            glyphs_.note(msgs[i].content);
+        }
+
+        for (size_t i = first; i < msgs.size() && row_offsets_[i] < view_bot; i++) {
+            MessageInfo& m = msgs[i];
+            ImGui::SetCursorPosY(base_y + row_offsets_[i] - shift);
+            ImGui::PushID(m.id);
 
-        for (auto& m : state.messages) {
             ImGui::TextColored(ImVec4(0.0f, 0.85f, 1.0f, 1.f), "%s", m.author.c_str());
             ImGui::SameLine();
-            ImGui::TextDisabled(" [%s]", format_ts(m.ts).c_str());
+            ImGui::TextDisabled(" [%s]", m.ts_text.c_str());
 
             bool own    = (m.author_id == state.user_id);
-            bool recent = ((int64_t)time(nullptr) - m.ts) <= 7LL * 24 * 3600;
+            bool recent = (now - m.ts) <= 7LL * 24 * 3600;
 
             if (editing_msg_id_ == m.id) {
                 ImGui::SetNextItemWidth(msg_w - 120.f);
@@ -511,10 +784,9 @@ void MainScreen::render_messages(AppState& state, WsClient& ws) {
                 ImGui::TextWrapped("%s", m.content.c_str());
 
                 if (own && recent) {
-                    std::string popup_id = "##ctx" + std::to_string(m.id);
                     if (ImGui::IsItemClicked(ImGuiMouseButton_Right))
-                        ImGui::OpenPopup(popup_id.c_str());
-                    if (ImGui::BeginPopup(popup_id.c_str())) {
+                        ImGui::OpenPopup("##ctx");
+                    if (ImGui::BeginPopup("##ctx")) {
                         if (ImGui::MenuItem("Edit")) {
                             editing_msg_id_ = m.id;
                             strncpy(edit_buf_, m.content.c_str(), sizeof(edit_buf_) - 1);
@@ -526,16 +798,36 @@ void MainScreen::render_messages(AppState& state, WsClient& ws) {
                     }
                 }
             }
+            ImGui::PopID();
         }
 
+        // Extend the scroll range over the rows that were skipped.
+        ImGui::SetCursorPosY(base_y + row_offsets_.back());
+        ImGui::Dummy(ImVec2(0.f, 0.f));
+
         if (state.scroll_to_bottom) {
             ImGui::SetScrollHereY(1.f);
             state.scroll_to_bottom = false;
+            at_bottom_             = !st.has_newer;
+        } else {
+            at_bottom_ = !st.has_newer &&
+                         scroll_y >= ImGui::GetScrollMaxY() - 1.f;
+
+            // Within a screen of either end of what is loaded: fetch a page
+            if (!history_loading_ && !msgs.empty()) {
+                if (st.has_older && view_top < view_h)
+                    page_request = -1;
+                else if (st.has_newer && view_bot > row_offsets_.back() - view_h)
+                    page_request = +1;
+            }
         }
     }
 
     ImGui::End();
 
+    if (page_request != 0)
+        load_history_page(state, http, page_request < 0);
+
     if (pending_delete > 0) {
         json j;
         j["op"]         = "MESSAGE_DELETE";
@@ -551,6 +843,24 @@ void MainScreen::render_messages(AppState& state, WsClient& ws) {
     }
 }
 
+// Height of one message row (header line + wrapped content) at `width`.
+// Cached on the message; the row being edited is a fixed-height input line.
+float MainScreen::message_height(MessageInfo& m, float width) {
+    const ImGuiStyle& style = ImGui::GetStyle();
+    if (m.ts_text.empty()) m.ts_text = format_ts(m.ts);
+
+    float header = ImGui::GetTextLineHeightWithSpacing();
+    if (editing_msg_id_ == m.id)
+        return header + ImGui::GetFrameHeightWithSpacing();
+
+    if (m.layout_w != width) {
+        ImVec2 text = ImGui::CalcTextSize(m.content.c_str(), nullptr, false, width);
+        m.layout_h  = header + text.y + style.ItemSpacing.y;
+        m.layout_w  = width;
+    }
+    return m.layout_h;
+}
+
 // ─── Message input ────────────────────────────────────────────────────────────
 
 void MainScreen::render_input(AppState& state, WsClient& ws) {
@@ -579,6 +889,7 @@ void MainScreen::render_input(AppState& state, WsClient& ws) {
     ImGui::SetNextItemWidth(io.DisplaySize.x - sidebar_w - members_w - 80.f);
     bool send = ImGui::InputText("##msg_input", input_buf_, sizeof(input_buf_),
                                  ImGuiInputTextFlags_EnterReturnsTrue);
+    glyphs_.note(input_buf_);
     ImGui::SameLine();
     send |= ImGui::Button("Send", ImVec2(60.f, 0));
 
@@ -586,7 +897,7 @@ void MainScreen::render_input(AppState& state, WsClient& ws) {
 
     if (send && !no_channel && strlen(input_buf_) > 0) {
         if (!ws.is_connected()) {
-            state.set_status("WebSocket not connected — try reconnecting", true);
+            state.set_status("WebSocket not connected — reconnecting...", true);
         } else {
             json msg;
             msg["op"]         = "MESSAGE_SEND";
@@ -603,7 +914,31 @@ void MainScreen::render_input(AppState& state, WsClient& ws) {
 
 // ─── Members panel ────────────────────────────────────────────────────────────
 
-void MainScreen::render_members(AppState& state) {
+// Keep the member-list window around the visible rows [first, last): move it
+// when the view comes within half a margin of an edge that is not the end of
+// the list, or subscribe when there is no window for the selected server.
+void MainScreen::subscribe_members(AppState& state, WsClient& ws, int first, int last) {
+    if (state.selected_server_id < 0 || !ws.is_connected()) return;
+
+    int  end         = member_sub_start_ + member_sub_count_;
+    bool fresh       = member_sub_server_ != state.selected_server_id;
+    bool near_top    = member_sub_start_ > 0 && first < member_sub_start_ + MEMBER_MARGIN / 2;
+    bool near_bottom = end < state.members_total && last > end - MEMBER_MARGIN / 2;
+    if (!fresh && !near_top && !near_bottom) return;
+
+    member_sub_server_ = state.selected_server_id;
+    member_sub_start_  = std::max(0, first - MEMBER_MARGIN);
+    member_sub_count_  = std::min(std::max(MEMBER_WINDOW, last - first + 2 * MEMBER_MARGIN),
+                                  MEMBER_WINDOW_MAX);
+    json sub;
+    sub["op"]        = "MEMBER_LIST_SUBSCRIBE";
+    sub["server_id"] = member_sub_server_;
+    sub["start"]     = member_sub_start_;
+    sub["count"]     = member_sub_count_;
+    ws.send(sub.dump());
+}
+
+void MainScreen::render_members(AppState& state, WsClient& ws) {
     ImGuiIO& io = ImGui::GetIO();
     const float members_w = 160.f;
 
@@ -621,48 +956,106 @@ void MainScreen::render_members(AppState& state) {
     // Voice participants
     if (state.voice_channel_id >= 0 && !state.voice_participants.empty()) {
         ImGui::TextColored(ImVec4(0.3f, 1.f, 0.5f, 0.9f), "  IN VOICE");
-        for (auto& p : state.voice_participants)
+        for (auto& p : state.voice_participants) {
+            glyphs_.note(p.username);
             ImGui::TextColored(ImVec4(0.3f, 1.f, 0.5f, 1.f), "  * %s", p.username.c_str());
+        }
         ImGui::Spacing();
     }
 
-    bool printed_online  = false;
-    bool printed_offline = false;
-    for (auto& m : state.members) {
-        if (!m.online) continue;
-        if (!printed_online) {
-            ImGui::TextColored(ImVec4(0.0f, 0.85f, 1.0f, 0.6f), "  ONLINE");
-            printed_online = true;
+    // Rows span the whole list, online first; only the subscribed window is
+    // held, so rows outside it are placeholders until the next MEMBER_LIST.
+    // The window's online members are rows members_start.., its offline ones
+    // follow from max(members_start, members_online).
+    const auto& online    = state.members.online();
+    const auto& offline   = state.members.offline();
+    const int   n_online  = state.members_online;
+    const int   n_offline = state.members_total - n_online;
+    const int   off_base  = std::max(state.members_start, n_online);
+    const float row_h     = ImGui::GetTextLineHeightWithSpacing();
+    int first = -1, last = 0;   // visible rows
+    auto track = [&](const ImGuiListClipper& c, int base) {
+        if (c.DisplayStart >= c.DisplayEnd) return;
+        if (first < 0) first = base + c.DisplayStart;
+        last = base + c.DisplayEnd;
+    };
+
+    if (n_online > 0) {
+        ImGui::TextColored(ImVec4(0.0f, 0.85f, 1.0f, 0.6f), "  ONLINE");
+        ImGuiListClipper clipper;
+        clipper.Begin(n_online, row_h);
+        while (clipper.Step()) {
+            track(clipper, 0);
+            for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; r++) {
+                int i = r - state.members_start;
+                if (i >= 0 && i < (int)online.size()) {
+                    glyphs_.note(online[i]->username);
+                    ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.5f, 1.f), "  * %s",
+                                       online[i]->username.c_str());
+                } else {
+                    ImGui::TextDisabled("  ...");
+                }
+            }
         }
-        ImGui::TextColored(ImVec4(0.2f, 1.0f, 0.5f, 1.f), "  * %s", m.username.c_str());
     }
     ImGui::Spacing();
-    for (auto& m : state.members) {
-        if (m.online) continue;
-        if (!printed_offline) {
-            ImGui::TextDisabled("  OFFLINE");
-            printed_offline = true;
+    if (n_offline > 0) {
+        ImGui::TextDisabled("  OFFLINE");
+        ImGuiListClipper clipper;
+        clipper.Begin(n_offline, row_h);
+        while (clipper.Step()) {
+            track(clipper, n_online);
+            for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; r++) {
+                int i = n_online + r - off_base;
+                if (i >= 0 && i < (int)offline.size()) {
+                    glyphs_.note(offline[i]->username);
+                    ImGui::TextDisabled("    %s", offline[i]->username.c_str());
+                } else {
+                    ImGui::TextDisabled("    ...");
+                }
+            }
         }
-        ImGui::TextDisabled("    %s", m.username.c_str());
     }
 
     ImGui::End();
+    subscribe_members(state, ws, std::max(first, 0), last);
 }
 
 // ─── Top-level update ─────────────────────────────────────────────────────────
 
 void MainScreen::update(AppState& state, HttpClient& http, WsClient& ws,
                         VoiceClient& voice) {
-    static int last_server_id = -1;
-    if (state.selected_server_id != last_server_id) {
-        last_server_id = state.selected_server_id;
-        if (state.selected_server_id >= 0)
-            load_members(state, http, state.selected_server_id);
+    if (!cache_tried_) open_cache(state);
+
+    // Glyph widths changed with the atlas: re-measure rows, keeping the view
+    if (glyphs_.generation() != glyph_generation_) {
+        glyph_generation_ = glyphs_.generation();
+        std::lock_guard<std::mutex> lk(state.msg_mutex);
+        for (auto& [id, st] : state.channel_stores)
+            for (auto& m : st.messages) m.layout_w = 0.f;
+        restore_anchor_ = true;
     }
 
-    process_incoming(state, ws, voice);
+    // The server drops voice membership with the old session
+    bool connected = ws.is_connected();
+    if (ws_was_connected_ && !connected) {
+        if (voice.is_active()) voice.stop();
+        state.voice_channel_id = -1;
+        state.voice_participants.clear();
+        state.set_status("Connection lost, reconnecting...", true);
+    }
+    ws_was_connected_ = connected;
+
+    process_incoming(state, ws);
+    if (reload_messages_) {
+        reload_messages_ = false;
+        if (state.selected_channel_id >= 0) {
+            std::lock_guard<std::mutex> lk(state.msg_mutex);
+            load_messages(state, http, state.selected_channel_id);
+        }
+    }
     render_sidebar(state, http, ws, voice);
-    render_messages(state, ws);
+    render_messages(state, http, ws);
     render_input(state, ws);
-    render_members(state);
+    render_members(state, ws);
 }
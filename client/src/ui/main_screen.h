@@ -3,29 +3,75 @@
 #include "../net/http_client.h"
 #include "../net/ws_client.h"
 #include "../net/voice_client.h"
+#include "../cache/message_cache.h"
+#include "glyph_cache.h"
 
 class MainScreen {
 public:
+    explicit MainScreen(GlyphCache& glyphs) : glyphs_(glyphs) {}
+
     // Process any pending WebSocket messages and render the main UI.
     void update(AppState& state, HttpClient& http, WsClient& ws, VoiceClient& voice);
 
 private:
+    // Text drawn here is noted so its glyphs get baked; layouts measured
+    // before a re-bake are redone
+    GlyphCache& glyphs_;
+    uint32_t    glyph_generation_ = 0;
+
     char input_buf_[2000] = {};
     int  editing_msg_id_  = -1;
     char edit_buf_[4001]  = {};
     bool refocus_input_   = false;
 
+    // Message list virtualization: row i starts at row_offsets_[i] (one
+    // extra entry holds the total height). Rebuilt from cached heights.
+    std::vector<float> row_offsets_;
+
+    // Scroll-back paging. The anchor is the first visible message and how far
+    // the view starts into it; after rows are added or removed above it the
+    // anchor is put back in place so the visible content does not jump.
+    bool  history_loading_ = false;
+    bool  at_bottom_       = true;
+    int   anchor_id_       = -1;
+    float anchor_delta_    = 0.f;
+    bool  restore_anchor_  = false;
+
+    // On-disk history, opened on the first update() after login
+    MessageCache cache_;
+    bool         cache_tried_ = false;
+
+    // Member-list window subscribed with MEMBER_LIST_SUBSCRIBE
+    int member_sub_server_ = -1;   // -1 = none on this connection
+    int member_sub_start_  = 0;
+    int member_sub_count_  = 0;
+
+    // Reconnect / resume
+    bool ws_was_connected_ = false;
+    bool reload_messages_  = false;  // set when RESUMED could not replay
+
     // Create channel dialog state
     bool show_create_channel_     = false;
     int  create_channel_server_id_ = -1;
     char new_channel_buf_[65]     = {};
     bool new_channel_is_voice_    = false; // false=text, true=voice
 
-    void process_incoming(AppState& state, WsClient& ws, VoiceClient& voice);
+    void process_incoming(AppState& state, WsClient& ws);
     void render_sidebar(AppState& state, HttpClient& http, WsClient& ws, VoiceClient& voice);
-    void render_messages(AppState& state, WsClient& ws);
+    void render_messages(AppState& state, HttpClient& http, WsClient& ws);
+    float message_height(MessageInfo& m, float width);
     void render_input(AppState& state, WsClient& ws);
-    void render_members(AppState& state);
+    void render_members(AppState& state, WsClient& ws);
+    void subscribe_members(AppState& state, WsClient& ws, int first, int last);
     void load_messages(AppState& state, HttpClient& http, int channel_id);
-    void load_members(AppState& state, HttpClient& http, int server_id);
+    void fetch_newest(AppState& state, HttpClient& http, int channel_id);
+    void fetch_delta(AppState& state, HttpClient& http, int channel_id, int after_id);
+    void load_history_page(AppState& state, HttpClient& http, bool older);
+    void merge_history_page(AppState& state, int channel_id, int cursor, bool older,
+                            std::vector<MessageInfo> page);
+    void open_cache(AppState& state);
+    void cache_newest(int channel_id, const std::vector<MessageInfo>& page);
+    void select_channel(AppState& state, HttpClient& http, int channel_id);
+    void send_text_channels(AppState& state, WsClient& ws, const char* op);
+    void sync_resume(AppState& state, WsClient& ws);
 };
@@ -0,0 +1,39 @@
+// Link seam for norichat_microbench: no-op versions of the libwebsockets
+// calls made by ws.cpp, so ws::protocol.callback can be driven with fake
+// lws* handles and no sockets. Frames "written" here are simply discarded.
+//
+// Keep in sync with the lws API used by src/ws/ws.cpp.
+
+#include <libwebsockets.h>
+#include <cstdio>
+
+int lws_write(struct lws* /*wsi*/, unsigned char* /*buf*/, size_t len,
+              enum lws_write_protocol /*protocol*/) {
+    return (int)len;
+}
+
+int lws_callback_on_writable(struct lws* /*wsi*/) { return 1; }
+
+int lws_is_first_fragment(struct lws* /*wsi*/) { return 1; }
+
+int lws_is_final_fragment(struct lws* /*wsi*/) { return 1; }
+
+struct lws_context* lws_get_context(const struct lws* /*wsi*/) { return nullptr; }
+
+// Every fake client is the same peer, so benches should lift the
+// connection limit with ws::set_conn_rate_limit(0, 0).
+const char* lws_get_peer_simple(struct lws* /*wsi*/, char* name, size_t namelen) {
+    snprintf(name, namelen, "127.0.0.1");
+    return name;
+}
+
+// Timeouts never fire either: fake sessions live until CLOSED is sent.
+void lws_set_timeout(struct lws* /*wsi*/, enum pending_timeout /*reason*/, int /*secs*/) {}
+
+void lws_close_reason(struct lws* /*wsi*/, enum lws_close_status /*status*/,
+                      unsigned char* /*buf*/, size_t /*len*/) {}
+
+// Timers never fire: batched presence diffs simply stay pending.
+void lws_sul_schedule(struct lws_context* /*ctx*/, int /*tsi*/,
+                      lws_sorted_usec_list_t* /*sul*/, sul_cb_t /*cb*/,
+                      lws_usec_t /*us*/) {}
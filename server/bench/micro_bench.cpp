@@ -0,0 +1,207 @@
+// norichat_microbench – regression baseline for the server's hot functions.
+//
+// Links the real auth/db/ws/metrics sources; libwebsockets is replaced by the
+// no-op seam in lws_stub.cpp so ws::protocol.callback can be driven with fake
+// connections. The database lives in a temp file removed at exit.
+
+#include "auth/auth.h"
+#include "db/db.h"
+#include "ws/ws.h"
+#include "../../shared/protocol/messages.h"
+
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// ─── Fixtures ─────────────────────────────────────────────────────────────────
+
+static std::string g_db_path;
+
+static void remove_db() {
+    for (const char* suffix : { "", "-wal", "-shm" })
+        std::remove((g_db_path + suffix).c_str());
+}
+
+// Open a fresh temp database on first use; the schema seeds channel 1.
+// Connection logging is off so the results table is not buried in it.
+static void ensure_db() {
+    if (!g_db_path.empty()) return;
+    ws::set_log_connections(false);
+    g_db_path = "/tmp/norichat_microbench_" + std::to_string(getpid()) + ".db";
+    remove_db();
+    if (!db::init(g_db_path.c_str())) {
+        fprintf(stderr, "[microbench] cannot open %s\n", g_db_path.c_str());
+        std::exit(1);
+    }
+    std::atexit([] { db::close(); remove_db(); });
+}
+
+// Users bench_0 … bench_{n-1}, all members of the default server.
+static const std::vector<int>& bench_users(size_t n) {
+    static std::vector<int> ids;
+    ensure_db();
+    while (ids.size() < n) {
+        std::string name = "bench_" + std::to_string(ids.size());
+        auto user = db::create_user(name, "x");
+        if (!user) { fprintf(stderr, "[microbench] create_user failed\n"); std::exit(1); }
+        db::add_membership(user->id, 1);
+        ids.push_back(user->id);
+    }
+    return ids;
+}
+
+static void ws_event(lws* wsi, lws_callback_reasons reason, const std::string& data = "") {
+    ws::protocol.callback(wsi, reason, nullptr,
+                          const_cast<char*>(data.data()), data.size());
+}
+
+// Drain whatever the session has queued (AUTH_OK, broadcasts, ...).
+static void ws_drain(lws* wsi, int frames) {
+    for (int i = 0; i < frames; i++) ws_event(wsi, LWS_CALLBACK_SERVER_WRITEABLE);
+}
+
+// `n` authenticated fake connections subscribed to channel 1. The handles are
+// never dereferenced by ws.cpp, only used as map keys and passed to lws.
+struct FakeSessions {
+    std::vector<char> storage;
+    std::vector<lws*> wsis;
+
+    explicit FakeSessions(size_t n) : storage(n) {
+        ws::set_conn_rate_limit(0, 0);   // all fake connections share one peer
+        const auto& users = bench_users(n);
+        for (size_t i = 0; i < n; i++) {
+            lws* wsi = reinterpret_cast<lws*>(&storage[i]);
+            wsis.push_back(wsi);
+            ws_event(wsi, LWS_CALLBACK_ESTABLISHED);
+
+            json auth_msg;
+            auth_msg["op"]    = OP_AUTH;
+            auth_msg["token"] = auth::generate_jwt(users[i], "bench_" + std::to_string(i));
+            ws_event(wsi, LWS_CALLBACK_RECEIVE, auth_msg.dump());
+
+            json join;
+            join["op"]         = OP_CHANNEL_JOIN;
+            join["channel_id"] = 1;
+            ws_event(wsi, LWS_CALLBACK_RECEIVE, join.dump());
+            ws_drain(wsi, 4);
+        }
+    }
+    ~FakeSessions() {
+        for (lws* wsi : wsis) ws_event(wsi, LWS_CALLBACK_CLOSED);
+    }
+};
+
+// ─── Auth ─────────────────────────────────────────────────────────────────────
+
+static void BM_HashPassword(benchmark::State& state) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(auth::hash_password("correct horse battery staple"));
+}
+BENCHMARK(BM_HashPassword);
+
+static void BM_GenerateJwt(benchmark::State& state) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(auth::generate_jwt(42, "benchmark_user"));
+}
+BENCHMARK(BM_GenerateJwt);
+
+static void BM_ValidateJwt(benchmark::State& state) {
+    std::string token = auth::generate_jwt(42, "benchmark_user");
+    for (auto _ : state)
+        benchmark::DoNotOptimize(auth::validate_jwt(token));
+}
+BENCHMARK(BM_ValidateJwt);
+
+static void BM_B64urlEncode(benchmark::State& state) {
+    std::string data((size_t)state.range(0), '\x5a');
+    for (auto _ : state)
+        benchmark::DoNotOptimize(auth::b64url_encode(data));
+    state.SetBytesProcessed((int64_t)state.iterations() * state.range(0));
+}
+BENCHMARK(BM_B64urlEncode)->Arg(32)->Arg(256)->Arg(4096);
+
+static void BM_B64urlDecode(benchmark::State& state) {
+    std::string encoded = auth::b64url_encode(std::string((size_t)state.range(0), '\x5a'));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(auth::b64url_decode(encoded));
+    state.SetBytesProcessed((int64_t)state.iterations() * state.range(0));
+}
+BENCHMARK(BM_B64urlDecode)->Arg(32)->Arg(256)->Arg(4096);
+
+// ─── JSON ─────────────────────────────────────────────────────────────────────
+
+// Same fields as handle_message_send's MESSAGE_NEW broadcast.
+static void BM_BuildMessageNew(benchmark::State& state) {
+    std::string content((size_t)state.range(0), 'x');
+    for (auto _ : state) {
+        json broadcast;
+        broadcast["op"]         = OP_MESSAGE_NEW;
+        broadcast["id"]         = (int64_t)123456;
+        broadcast["channel_id"] = 1;
+        broadcast["author_id"]  = 42;
+        broadcast["author"]     = "benchmark_user";
+        broadcast["content"]    = content;
+        broadcast["ts"]         = (int64_t)time(nullptr);
+        benchmark::DoNotOptimize(broadcast.dump());
+    }
+}
+BENCHMARK(BM_BuildMessageNew)->Arg(64)->Arg(1024)->Arg(MAX_MSG_LEN);
+
+// ─── Database ─────────────────────────────────────────────────────────────────
+
+static void BM_DbAddMessage(benchmark::State& state) {
+    int author = bench_users(1)[0];
+    std::string content(64, 'x');
+    for (auto _ : state)
+        benchmark::DoNotOptimize(db::add_message(1, author, content));
+}
+BENCHMARK(BM_DbAddMessage);
+
+static void BM_DbGetMessages(benchmark::State& state) {
+    int author = bench_users(1)[0];
+    static bool seeded = false;
+    if (!seeded) {
+        for (int i = 0; i < 10000; i++) db::add_message(1, author, "seed message");
+        seeded = true;
+    }
+    for (auto _ : state)
+        benchmark::DoNotOptimize(db::get_messages(1, (int)state.range(0)));
+    state.SetItemsProcessed((int64_t)state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DbGetMessages)->Arg(DEFAULT_MSG_LIMIT)->Arg(200);
+
+// ─── Broadcast ────────────────────────────────────────────────────────────────
+
+// Fan-out cost only: write queues are drained outside the timed region.
+static void BM_BroadcastToChannel(benchmark::State& state) {
+    FakeSessions sessions((size_t)state.range(0));
+    json msg;
+    msg["op"]         = OP_MESSAGE_NEW;
+    msg["id"]         = 1;
+    msg["channel_id"] = 1;
+    msg["author_id"]  = 1;
+    msg["author"]     = "benchmark_user";
+    msg["content"]    = std::string(64, 'x');
+    msg["ts"]         = (int64_t)time(nullptr);
+    const std::string payload = msg.dump();
+
+    for (auto _ : state) {
+        ws::broadcast_to_channel(1, payload);
+        state.PauseTiming();
+        for (lws* wsi : sessions.wsis) ws_drain(wsi, 1);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BroadcastToChannel)->Arg(10)->Arg(100)->Arg(1000);
+
+BENCHMARK_MAIN();
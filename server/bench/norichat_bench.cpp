@@ -0,0 +1,488 @@
+// norichat_bench – WebSocket load generator for a local norichat_server.
+//
+// Registers (or logs in) N synthetic users over the REST API, opens one
+// WebSocket session per user, joins a text channel and sends messages at a
+// fixed per-user rate, optionally streaming synthetic voice frames too.
+// Every message carries its send timestamp, so each delivery to each
+// subscriber yields one end-to-end latency sample. All sessions are driven
+// from a single lws service loop, like the server itself.
+
+#include "../../shared/protocol/messages.h"
+
+#include <libwebsockets.h>
+#include <nlohmann/json.hpp>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// ─── Config ───────────────────────────────────────────────────────────────────
+
+struct Config {
+    std::string host          = "127.0.0.1";
+    int         port          = 8080;
+    int         users         = 50;
+    std::string prefix        = "bench_";
+    std::string password      = "bench_password";
+    int         channel_id    = 1;
+    double      rate          = 1.0;   // messages per second per user
+    int         msg_size      = 64;    // payload bytes per message
+    int         duration_sec  = 10;
+    int         voice_channel = 0;     // 0 = no voice
+    int         voice_fps     = 50;    // 20 ms frames
+    int         voice_bytes   = 160;   // encoded frame size
+};
+
+static Config g_cfg;
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --host H            server host (default 127.0.0.1)\n"
+        "  --port P            server port (default 8080)\n"
+        "  --users N           concurrent sessions (default 50)\n"
+        "  --prefix S          username prefix (default bench_)\n"
+        "  --channel ID        text channel to join and post in (default 1)\n"
+        "  --rate R            messages per second per user (default 1)\n"
+        "  --size B            message payload bytes (default 64)\n"
+        "  --duration S        send phase length in seconds (default 10)\n"
+        "  --voice-channel ID  also stream voice frames into this channel\n"
+        "  --voice-fps N       voice frames per second per user (default 50)\n"
+        "  --voice-bytes B     voice frame size before base64 (default 160)\n",
+        argv0);
+}
+
+static bool parse_args(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        auto arg = [&](const char* name) {
+            return strcmp(argv[i], name) == 0 && i + 1 < argc;
+        };
+        if      (arg("--host"))          g_cfg.host          = argv[++i];
+        else if (arg("--port"))          g_cfg.port          = atoi(argv[++i]);
+        else if (arg("--users"))         g_cfg.users         = atoi(argv[++i]);
+        else if (arg("--prefix"))        g_cfg.prefix        = argv[++i];
+        else if (arg("--channel"))       g_cfg.channel_id    = atoi(argv[++i]);
+        else if (arg("--rate"))          g_cfg.rate          = atof(argv[++i]);
+        else if (arg("--size"))          g_cfg.msg_size      = atoi(argv[++i]);
+        else if (arg("--duration"))      g_cfg.duration_sec  = atoi(argv[++i]);
+        else if (arg("--voice-channel")) g_cfg.voice_channel = atoi(argv[++i]);
+        else if (arg("--voice-fps"))     g_cfg.voice_fps     = atoi(argv[++i]);
+        else if (arg("--voice-bytes"))   g_cfg.voice_bytes   = atoi(argv[++i]);
+        else return false;
+    }
+    return g_cfg.users > 0 && g_cfg.rate >= 0 && g_cfg.duration_sec > 0 &&
+           g_cfg.msg_size > 0 && g_cfg.msg_size <= MAX_MSG_LEN;
+}
+
+// ─── Clock ────────────────────────────────────────────────────────────────────
+
+static int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ─── REST (blocking, plain HTTP/1.1 over a socket) ────────────────────────────
+
+// POST `body` to `path`; returns the HTTP status (or -1) and fills `resp_body`.
+static int http_post(const std::string& path, const std::string& body,
+                     std::string& resp_body) {
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::string port = std::to_string(g_cfg.port);
+    if (getaddrinfo(g_cfg.host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    std::string req =
+        "POST " + path + " HTTP/1.1\r\n"
+        "Host: " + g_cfg.host + "\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    for (size_t off = 0; off < req.size();) {
+        ssize_t n = ::send(fd, req.data() + off, req.size() - off, 0);
+        if (n <= 0) { ::close(fd); return -1; }
+        off += (size_t)n;
+    }
+
+    std::string raw;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) raw.append(buf, (size_t)n);
+    ::close(fd);
+
+    int status = -1;
+    if (sscanf(raw.c_str(), "HTTP/1.%*d %d", &status) != 1) return -1;
+    auto hdr_end = raw.find("\r\n\r\n");
+    resp_body = (hdr_end == std::string::npos) ? "" : raw.substr(hdr_end + 4);
+    return status;
+}
+
+// Register `username`, falling back to login if it already exists.
+static bool obtain_token(const std::string& username, std::string& token) {
+    json req;
+    req["username"] = username;
+    req["password"] = g_cfg.password;
+
+    std::string body;
+    int status = http_post(API_REGISTER, req.dump(), body);
+    if (status == 409)
+        status = http_post(API_LOGIN, req.dump(), body);
+    if (status != 200 && status != 201) {
+        fprintf(stderr, "[bench] auth for %s failed (HTTP %d)\n", username.c_str(), status);
+        return false;
+    }
+    try {
+        token = json::parse(body).value("token", "");
+    } catch (...) {
+        return false;
+    }
+    return !token.empty();
+}
+
+// ─── Sessions ─────────────────────────────────────────────────────────────────
+
+struct Client {
+    int                     index     = 0;
+    std::string             token;
+    lws*                    wsi       = nullptr;
+    bool                    ready     = false;   // AUTH_OK received, channels joined
+    bool                    closed    = false;
+    std::deque<std::string> out;
+    std::string             recv_buf;
+    int64_t                 next_msg_us   = 0;
+    int64_t                 next_voice_us = 0;
+    uint64_t                seq           = 0;
+};
+
+static std::vector<Client> g_clients;
+static lws_context*        g_ctx         = nullptr;
+static volatile int        g_interrupted = 0;
+
+// ─── Stats ────────────────────────────────────────────────────────────────────
+
+struct Stats {
+    uint64_t             connected       = 0;
+    uint64_t             sent            = 0;
+    uint64_t             delivered       = 0;   // MESSAGE_NEW for our own payloads
+    uint64_t             voice_sent      = 0;
+    uint64_t             voice_received  = 0;
+    uint64_t             connect_errors  = 0;
+    uint64_t             server_errors   = 0;   // ERROR / AUTH_FAIL ops
+    uint64_t             rate_limited    = 0;   // RATE_LIMITED (first drop of each run)
+    uint64_t             unexpected_close = 0;
+    std::vector<int64_t> latency_us;
+};
+
+static Stats g_stats;
+static bool  g_closing = false;   // sessions are being shut down
+
+// ─── lws client callback ──────────────────────────────────────────────────────
+
+static void queue(Client& c, const json& msg) {
+    c.out.push_back(msg.dump());
+    lws_callback_on_writable(c.wsi);
+}
+
+static void on_message(Client& c, const std::string& raw) {
+    json msg;
+    try { msg = json::parse(raw); } catch (...) { g_stats.server_errors++; return; }
+    std::string op = msg.value("op", "");
+
+    if (op == OP_AUTH_OK) {
+        json join;
+        join["op"]         = OP_CHANNEL_JOIN;
+        join["channel_id"] = g_cfg.channel_id;
+        queue(c, join);
+        if (g_cfg.voice_channel > 0) {
+            json vjoin;
+            vjoin["op"]         = OP_VOICE_JOIN;
+            vjoin["channel_id"] = g_cfg.voice_channel;
+            queue(c, vjoin);
+        }
+        c.ready = true;
+        g_stats.connected++;
+    } else if (op == OP_MESSAGE_NEW) {
+        // Payload: "bench <sender> <seq> <send_us> <padding>"
+        std::string content = msg.value("content", "");
+        int     sender  = 0;
+        uint64_t seq    = 0;
+        int64_t send_us = 0;
+        if (sscanf(content.c_str(), "bench %d %" SCNu64 " %" SCNd64,
+                   &sender, &seq, &send_us) == 3) {
+            g_stats.delivered++;
+            g_stats.latency_us.push_back(now_us() - send_us);
+        }
+    } else if (op == OP_VOICE_DATA) {
+        g_stats.voice_received++;
+    } else if (op == OP_RATE_LIMITED) {
+        g_stats.rate_limited++;
+    } else if (op == OP_ERROR || op == OP_AUTH_FAIL) {
+        g_stats.server_errors++;
+        if (g_stats.server_errors <= 10)
+            fprintf(stderr, "[bench] client %d: %s\n", c.index, raw.c_str());
+    }
+}
+
+static int bench_callback(lws* wsi, lws_callback_reasons reason,
+                          void* user, void* in, size_t len) {
+    Client* c = static_cast<Client*>(lws_get_opaque_user_data(wsi));
+    (void)user;
+    if (!c) return 0;
+
+    switch (reason) {
+    case LWS_CALLBACK_CLIENT_ESTABLISHED: {
+        json auth_msg;
+        auth_msg["op"]    = OP_AUTH;
+        auth_msg["token"] = c->token;
+        queue(*c, auth_msg);
+        break;
+    }
+
+    case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+        g_stats.connect_errors++;
+        fprintf(stderr, "[bench] client %d: connection error: %s\n", c->index,
+                in ? static_cast<const char*>(in) : "?");
+        c->wsi    = nullptr;
+        c->closed = true;
+        break;
+
+    case LWS_CALLBACK_CLIENT_RECEIVE:
+        c->recv_buf.append(static_cast<const char*>(in), len);
+        if (!lws_is_final_fragment(wsi)) break;
+        on_message(*c, c->recv_buf);
+        c->recv_buf.clear();
+        break;
+
+    case LWS_CALLBACK_CLIENT_WRITEABLE: {
+        if (c->out.empty()) break;
+        const std::string& msg = c->out.front();
+        std::vector<unsigned char> buf(LWS_PRE + msg.size());
+        memcpy(buf.data() + LWS_PRE, msg.data(), msg.size());
+        if (lws_write(wsi, buf.data() + LWS_PRE, msg.size(), LWS_WRITE_TEXT) < (int)msg.size())
+            g_stats.server_errors++;
+        c->out.pop_front();
+        if (!c->out.empty()) lws_callback_on_writable(wsi);
+        break;
+    }
+
+    case LWS_CALLBACK_CLIENT_CLOSED:
+        if (!g_closing) g_stats.unexpected_close++;
+        c->wsi    = nullptr;
+        c->closed = true;
+        c->ready  = false;
+        break;
+
+    default:
+        break;
+    }
+    return 0;
+}
+
+static lws_protocols g_protocols[] = {
+    { "norichat", bench_callback, 0, WS_RX_BUFFER, 0, nullptr, 0 },
+    LWS_PROTOCOL_LIST_TERM
+};
+
+static void connect_client(Client& c) {
+    lws_client_connect_info cci;
+    memset(&cci, 0, sizeof(cci));
+    cci.context          = g_ctx;
+    cci.address          = g_cfg.host.c_str();
+    cci.port             = g_cfg.port;
+    cci.path             = "/ws";
+    cci.host             = g_cfg.host.c_str();
+    cci.origin           = g_cfg.host.c_str();
+    cci.protocol         = g_protocols[0].name;
+    cci.opaque_user_data = &c;
+    cci.pwsi             = &c.wsi;
+    if (!lws_client_connect_via_info(&cci)) {
+        g_stats.connect_errors++;
+        c.closed = true;
+    }
+}
+
+// ─── Traffic ──────────────────────────────────────────────────────────────────
+
+static std::string g_voice_b64;   // one synthetic frame, reused
+
+static void build_voice_frame() {
+    std::string raw((size_t)g_cfg.voice_bytes, '\0');
+    for (size_t i = 0; i < raw.size(); i++) raw[i] = (char)(i * 31 + 7);
+    static const char* tbl =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < raw.size(); i += 3) {
+        uint32_t n = (uint32_t)(uint8_t)raw[i] << 16;
+        if (i + 1 < raw.size()) n |= (uint32_t)(uint8_t)raw[i + 1] << 8;
+        if (i + 2 < raw.size()) n |= (uint32_t)(uint8_t)raw[i + 2];
+        g_voice_b64 += tbl[(n >> 18) & 63];
+        g_voice_b64 += tbl[(n >> 12) & 63];
+        g_voice_b64 += (i + 1 < raw.size()) ? tbl[(n >> 6) & 63] : '=';
+        g_voice_b64 += (i + 2 < raw.size()) ? tbl[n & 63] : '=';
+    }
+}
+
+static void send_due(int64_t now) {
+    const int64_t msg_interval   = g_cfg.rate > 0 ? (int64_t)(1e6 / g_cfg.rate) : 0;
+    const int64_t voice_interval = g_cfg.voice_fps > 0 ? 1000000 / g_cfg.voice_fps : 0;
+
+    for (auto& c : g_clients) {
+        if (!c.ready || !c.wsi) continue;
+
+        while (msg_interval > 0 && c.next_msg_us <= now) {
+            char head[96];
+            int n = snprintf(head, sizeof(head), "bench %d %" PRIu64 " %" PRId64 " ",
+                             c.index, c.seq++, now);
+            std::string content(head, (size_t)n);
+            if ((int)content.size() < g_cfg.msg_size)
+                content.append((size_t)g_cfg.msg_size - content.size(), 'x');
+
+            json msg;
+            msg["op"]         = OP_MESSAGE_SEND;
+            msg["channel_id"] = g_cfg.channel_id;
+            msg["content"]    = content;
+            queue(c, msg);
+            g_stats.sent++;
+            c.next_msg_us += msg_interval;
+        }
+
+        while (g_cfg.voice_channel > 0 && voice_interval > 0 && c.next_voice_us <= now) {
+            json frame;
+            frame["op"]         = OP_VOICE_DATA;
+            frame["channel_id"] = g_cfg.voice_channel;
+            frame["data"]       = g_voice_b64;
+            queue(c, frame);
+            g_stats.voice_sent++;
+            c.next_voice_us += voice_interval;
+        }
+    }
+}
+
+// ─── Report ───────────────────────────────────────────────────────────────────
+
+static double percentile_ms(std::vector<int64_t>& v, double p) {
+    if (v.empty()) return 0.0;
+    size_t idx = (size_t)(p * (double)(v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + (long)idx, v.end());
+    return (double)v[idx] / 1000.0;
+}
+
+static void report(double send_sec) {
+    auto& lat = g_stats.latency_us;
+    int ready = 0;
+    for (auto& c : g_clients) ready += c.ready ? 1 : 0;
+
+    fprintf(stdout, "\n── norichat_bench ──────────────────────────────────────\n");
+    fprintf(stdout, "sessions        %d requested, %" PRIu64 " authenticated, %d open at end\n",
+            g_cfg.users, g_stats.connected, ready);
+    fprintf(stdout, "messages        %" PRIu64 " sent, %" PRIu64 " deliveries\n",
+            g_stats.sent, g_stats.delivered);
+    fprintf(stdout, "throughput      %.1f msg/s sent, %.1f deliveries/s\n",
+            g_stats.sent / send_sec, g_stats.delivered / send_sec);
+    if (g_cfg.voice_channel > 0)
+        fprintf(stdout, "voice frames    %" PRIu64 " sent, %" PRIu64 " received\n",
+                g_stats.voice_sent, g_stats.voice_received);
+    fprintf(stdout, "latency (ms)    p50 %.2f  p99 %.2f  p999 %.2f  max %.2f\n",
+            percentile_ms(lat, 0.50), percentile_ms(lat, 0.99),
+            percentile_ms(lat, 0.999), percentile_ms(lat, 1.0));
+    fprintf(stdout, "errors          %" PRIu64 " connect, %" PRIu64 " server, %" PRIu64
+            " rate limited, %" PRIu64 " unexpected close\n",
+            g_stats.connect_errors, g_stats.server_errors, g_stats.rate_limited,
+            g_stats.unexpected_close);
+}
+
+// ─── Entry point ──────────────────────────────────────────────────────────────
+
+static void sigint_handler(int) { g_interrupted = 1; }
+
+int main(int argc, char* argv[]) {
+    if (!parse_args(argc, argv)) { usage(argv[0]); return 2; }
+    signal(SIGINT, sigint_handler);
+
+    // ── Accounts ──────────────────────────────────────────────────────────────
+    g_clients.resize((size_t)g_cfg.users);
+    for (int i = 0; i < g_cfg.users; i++) {
+        g_clients[i].index = i;
+        if (!obtain_token(g_cfg.prefix + std::to_string(i), g_clients[i].token)) {
+            fprintf(stderr, "[bench] cannot obtain a token; is the server running on %s:%d?\n",
+                    g_cfg.host.c_str(), g_cfg.port);
+            return 1;
+        }
+    }
+    fprintf(stdout, "[bench] %d accounts ready\n", g_cfg.users);
+    if (g_cfg.voice_channel > 0) build_voice_frame();
+
+    // ── Sessions ──────────────────────────────────────────────────────────────
+    lws_context_creation_info info;
+    memset(&info, 0, sizeof(info));
+    info.port      = CONTEXT_PORT_NO_LISTEN;
+    info.protocols = g_protocols;
+    info.fd_limit_per_thread = (unsigned int)g_cfg.users + 64;
+    lws_set_log_level(LLL_ERR, nullptr);
+
+    g_ctx = lws_create_context(&info);
+    if (!g_ctx) { fprintf(stderr, "[bench] failed to create lws context\n"); return 1; }
+
+    for (auto& c : g_clients) connect_client(c);
+
+    // Wait (up to 10 s) for every session to authenticate.
+    int64_t deadline = now_us() + 10 * 1000000LL;
+    while (!g_interrupted && now_us() < deadline) {
+        int settled = 0;
+        for (auto& c : g_clients) settled += (c.ready || c.closed) ? 1 : 0;
+        if (settled == g_cfg.users) break;
+        lws_service(g_ctx, 10);
+    }
+    fprintf(stdout, "[bench] %" PRIu64 "/%d sessions authenticated\n",
+            g_stats.connected, g_cfg.users);
+
+    // ── Send phase ────────────────────────────────────────────────────────────
+    // Stagger first sends across one interval so users don't fire in lockstep.
+    int64_t start = now_us();
+    for (auto& c : g_clients) {
+        int64_t spread = g_cfg.rate > 0 ? (int64_t)(1e6 / g_cfg.rate) : 0;
+        c.next_msg_us   = start + (spread * c.index) / g_cfg.users;
+        c.next_voice_us = start;
+    }
+    int64_t send_end = start + (int64_t)g_cfg.duration_sec * 1000000LL;
+    while (!g_interrupted && now_us() < send_end) {
+        send_due(now_us());
+        lws_service(g_ctx, 1);
+    }
+    double send_sec = (double)(now_us() - start) / 1e6;
+
+    // ── Drain: let in-flight deliveries arrive (2 s) ──────────────────────────
+    int64_t drain_end = now_us() + 2 * 1000000LL;
+    while (!g_interrupted && now_us() < drain_end)
+        lws_service(g_ctx, 10);
+
+    g_closing = true;
+    report(send_sec);
+    lws_context_destroy(g_ctx);
+    return (g_stats.connect_errors || g_stats.server_errors) ? 1 : 0;
+}
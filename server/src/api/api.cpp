@@ -1,11 +1,14 @@
 #include "api.h"
 #include "../auth/auth.h"
 #include "../db/db.h"
+#include "../metrics/metrics.h"
+#include "../ws/ws.h"
 #include "../../../shared/protocol/messages.h"
 
 #include <nlohmann/json.hpp>
 #include <cstdio>
 #include <cstring>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -36,8 +39,9 @@ static std::string uri_path(const char* uri) {
     return std::string(uri, q);
 }
 
-// Write a JSON response and close the HTTP transaction.
-static int send_json(lws* wsi, int status, const std::string& body) {
+// Write a response and close the HTTP transaction.
+static int send_response(lws* wsi, int status, const char* content_type,
+                         const std::string& body) {
     const size_t blen = body.size();
 
     // Headers buffer
@@ -47,7 +51,7 @@ static int send_json(lws* wsi, int status, const std::string& body) {
 
     if (lws_add_http_header_status(wsi, (unsigned int)status, &p, end))          return -1;
     if (lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_CONTENT_TYPE,
-            (unsigned char*)"application/json", 16, &p, end))                    return -1;
+            (unsigned char*)content_type, (int)strlen(content_type), &p, end))   return -1;
     if (lws_add_http_header_content_length(wsi, blen, &p, end))                  return -1;
     if (lws_add_http_header_by_name(wsi,
             (unsigned char*)"Access-Control-Allow-Origin:",
@@ -65,12 +69,53 @@ static int send_json(lws* wsi, int status, const std::string& body) {
     return lws_http_transaction_completed(wsi);
 }
 
+static int send_json(lws* wsi, int status, const std::string& body) {
+    return send_response(wsi, status, "application/json", body);
+}
+
 static int send_error_json(lws* wsi, int status, const std::string& msg) {
     json j;
     j["error"] = msg;
     return send_json(wsi, status, j.dump());
 }
 
+// ─── JSON builders ────────────────────────────────────────────────────────────
+
+static json server_json(const Server& sv) {
+    json o;
+    o["id"]       = sv.id;
+    o["name"]     = sv.name;
+    o["owner_id"] = sv.owner_id;
+    return o;
+}
+
+static json channel_json(const Channel& ch) {
+    json o;
+    o["id"]        = ch.id;
+    o["server_id"] = ch.server_id;
+    o["name"]      = ch.name;
+    o["type"]      = ch.type;
+    return o;
+}
+
+static json member_json(const Member& m) {
+    json o;
+    o["id"]       = m.id;
+    o["username"] = m.username;
+    return o;
+}
+
+static json message_json(const Message& m) {
+    json o;
+    o["id"]         = m.id;
+    o["channel_id"] = m.channel_id;
+    o["author_id"]  = m.author_id;
+    o["author"]     = m.author_name;
+    o["content"]    = m.content;
+    o["ts"]         = m.ts;
+    return o;
+}
+
 // ─── Route handlers ───────────────────────────────────────────────────────────
 
 static int handle_register(lws* wsi, api::HttpSession* s) {
@@ -134,13 +179,8 @@ static int handle_get_servers(lws* wsi, api::HttpSession* s) {
 
     auto servers = db::get_user_servers(*uid);
     json arr = json::array();
-    for (auto& sv : servers) {
-        json o;
-        o["id"]       = sv.id;
-        o["name"]     = sv.name;
-        o["owner_id"] = sv.owner_id;
-        arr.push_back(o);
-    }
+    for (auto& sv : servers)
+        arr.push_back(server_json(sv));
     return send_json(wsi, 200, arr.dump());
 }
 
@@ -158,14 +198,8 @@ static int handle_get_channels(lws* wsi, api::HttpSession* s) {
 
     auto channels = db::get_server_channels(server_id);
     json arr = json::array();
-    for (auto& ch : channels) {
-        json o;
-        o["id"]        = ch.id;
-        o["server_id"] = ch.server_id;
-        o["name"]      = ch.name;
-        o["type"]      = ch.type;
-        arr.push_back(o);
-    }
+    for (auto& ch : channels)
+        arr.push_back(channel_json(ch));
     return send_json(wsi, 200, arr.dump());
 }
 
@@ -183,12 +217,8 @@ static int handle_get_members(lws* wsi, api::HttpSession* s) {
 
     auto members = db::get_server_members(server_id);
     json arr = json::array();
-    for (auto& m : members) {
-        json o;
-        o["id"]       = m.id;
-        o["username"] = m.username;
-        arr.push_back(o);
-    }
+    for (auto& m : members)
+        arr.push_back(member_json(m));
     return send_json(wsi, 200, arr.dump());
 }
 
@@ -201,34 +231,85 @@ static int handle_get_messages(lws* wsi, api::HttpSession* s) {
     if (cid_str.empty()) return send_error_json(wsi, 400, "channel_id required");
     int channel_id = std::stoi(cid_str);
 
+    if (!db::can_access_channel(*uid, channel_id))
+        return send_error_json(wsi, 403, "not a member of this server");
+
     std::string lim_str = query_param(s->uri, "limit");
     int limit = lim_str.empty() ? DEFAULT_MSG_LIMIT : std::stoi(lim_str);
     if (limit <= 0 || limit > 200) limit = DEFAULT_MSG_LIMIT;
 
-    auto msgs = db::get_messages(channel_id, limit);
+    // Paging cursors: the page before or after a message id
+    std::string before_str = query_param(s->uri, "before");
+    std::string after_str  = query_param(s->uri, "after");
+    if (!before_str.empty() && !after_str.empty())
+        return send_error_json(wsi, 400, "before and after are exclusive");
+    int before_id = before_str.empty() ? 0 : std::stoi(before_str);
+    int after_id  = after_str.empty()  ? 0 : std::stoi(after_str);
+
+    auto msgs = db::get_messages(channel_id, limit, before_id, after_id);
     json arr = json::array();
-    for (auto& m : msgs) {
-        json o;
-        o["id"]         = m.id;
-        o["channel_id"] = m.channel_id;
-        o["author_id"]  = m.author_id;
-        o["author"]     = m.author_name;
-        o["content"]    = m.content;
-        o["ts"]         = m.ts;
-        arr.push_back(o);
-    }
+    for (auto& m : msgs)
+        arr.push_back(message_json(m));
     return send_json(wsi, 200, arr.dump());
 }
 
-// ─── Dispatch ─────────────────────────────────────────────────────────────────
+// Everything the client needs after login in one round trip: the user's
+// servers, plus channels, members (with presence) and recent history of the
+// selected server (`server_id`, default: first one) and its first text channel.
+// `lazy_members=1` leaves members empty for clients that page them over the
+// WebSocket (MEMBER_LIST_SUBSCRIBE).
+static int handle_bootstrap(lws* wsi, api::HttpSession* s) {
+    std::string token = auth::bearer_token(s->auth_header);
+    auto uid = auth::validate_jwt(token);
+    if (!uid) return send_error_json(wsi, 401, "unauthorized");
 
-static int dispatch_get(lws* wsi, api::HttpSession* s) {
-    std::string path = uri_path(s->uri);
-    if (path == API_SERVERS)  return handle_get_servers(wsi, s);
-    if (path == API_CHANNELS) return handle_get_channels(wsi, s);
-    if (path == API_MESSAGES) return handle_get_messages(wsi, s);
-    if (path == API_MEMBERS)  return handle_get_members(wsi, s);
-    return send_error_json(wsi, 404, "not found");
+    auto servers = db::get_user_servers(*uid);
+    json resp;
+    resp["servers"]    = json::array();
+    resp["server_id"]  = -1;
+    resp["channels"]   = json::array();
+    resp["members"]    = json::array();
+    resp["channel_id"] = -1;
+    resp["messages"]   = json::array();
+    for (auto& sv : servers)
+        resp["servers"].push_back(server_json(sv));
+    if (servers.empty()) return send_json(wsi, 200, resp.dump());
+
+    int server_id = servers[0].id;
+    std::string sid_str = query_param(s->uri, "server_id");
+    if (!sid_str.empty()) {
+        server_id = std::stoi(sid_str);
+        if (!db::has_membership(*uid, server_id))
+            return send_error_json(wsi, 403, "not a member of this server");
+    }
+    resp["server_id"] = server_id;
+
+    int channel_id = -1;
+    for (auto& ch : db::get_server_channels(server_id)) {
+        if (channel_id < 0 && ch.type == "text") channel_id = ch.id;
+        resp["channels"].push_back(channel_json(ch));
+    }
+
+    if (query_param(s->uri, "lazy_members") != "1") {
+        for (auto& m : db::get_server_members(server_id)) {
+            json o = member_json(m);
+            o["online"] = ws::is_user_online(m.id);
+            resp["members"].push_back(o);
+        }
+    }
+
+    if (channel_id >= 0) {
+        resp["channel_id"] = channel_id;
+        for (auto& m : db::get_messages(channel_id, DEFAULT_MSG_LIMIT))
+            resp["messages"].push_back(message_json(m));
+    }
+    return send_json(wsi, 200, resp.dump());
+}
+
+// Prometheus scrape endpoint; unauthenticated like any /metrics exporter, so
+// keep the port firewalled from the public if that matters.
+static int handle_metrics(lws* wsi, api::HttpSession* /*s*/) {
+    return send_response(wsi, 200, "text/plain; version=0.0.4", metrics::render());
 }
 
 static int handle_create_channel(lws* wsi, api::HttpSession* s) {
@@ -257,20 +338,57 @@ static int handle_create_channel(lws* wsi, api::HttpSession* s) {
     if (!ch)
         return send_error_json(wsi, 500, "failed to create channel");
 
-    json resp;
-    resp["id"]        = ch->id;
-    resp["server_id"] = ch->server_id;
-    resp["name"]      = ch->name;
-    resp["type"]      = ch->type;
-    return send_json(wsi, 201, resp.dump());
+    return send_json(wsi, 201, channel_json(*ch).dump());
 }
 
-static int dispatch_post(lws* wsi, api::HttpSession* s) {
+// ─── Dispatch ─────────────────────────────────────────────────────────────────
+
+struct Route {
+    const char* path;
+    int       (*handle)(lws*, api::HttpSession*);
+};
+
+static const Route GET_ROUTES[] = {
+    { API_SERVERS,   handle_get_servers  },
+    { API_CHANNELS,  handle_get_channels },
+    { API_MESSAGES,  handle_get_messages },
+    { API_MEMBERS,   handle_get_members  },
+    { API_BOOTSTRAP, handle_bootstrap    },
+    { API_METRICS,   handle_metrics      },
+};
+
+static const Route POST_ROUTES[] = {
+    { API_REGISTER, handle_register       },
+    { API_LOGIN,    handle_login          },
+    { API_CHANNELS, handle_create_channel },
+};
+
+// Run the handler for the request path, timing it into
+// norichat_http_request_seconds. `latency` caches one histogram per route
+// plus a trailing one for unmatched paths.
+template <size_t N>
+static int dispatch(lws* wsi, api::HttpSession* s, const char* method,
+                    const Route (&routes)[N], metrics::Histogram* (&latency)[N + 1]) {
     std::string path = uri_path(s->uri);
-    if (path == API_REGISTER) return handle_register(wsi, s);
-    if (path == API_LOGIN)    return handle_login(wsi, s);
-    if (path == API_CHANNELS) return handle_create_channel(wsi, s);
-    return send_error_json(wsi, 404, "not found");
+    size_t i = 0;
+    while (i < N && path != routes[i].path) i++;
+
+    if (!latency[i])
+        latency[i] = &metrics::http_latency(method, i < N ? routes[i].path : "other");
+    metrics::ScopedTimer timer(*latency[i]);
+
+    if (i == N) return send_error_json(wsi, 404, "not found");
+    return routes[i].handle(wsi, s);
+}
+
+static int dispatch_get(lws* wsi, api::HttpSession* s) {
+    static metrics::Histogram* latency[std::size(GET_ROUTES) + 1] = {};
+    return dispatch(wsi, s, "GET", GET_ROUTES, latency);
+}
+
+static int dispatch_post(lws* wsi, api::HttpSession* s) {
+    static metrics::Histogram* latency[std::size(POST_ROUTES) + 1] = {};
+    return dispatch(wsi, s, "POST", POST_ROUTES, latency);
 }
 
 // ─── lws callback ─────────────────────────────────────────────────────────────
@@ -1,4 +1,5 @@
 #include "auth.h"
+#include "../metrics/metrics.h"
 
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
@@ -47,8 +48,8 @@ static std::string b64url_encode(const unsigned char* data, size_t len) {
     return out;
 }
 
-static std::string b64url_encode(const std::string& s) {
-    return b64url_encode(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+std::string auth::b64url_encode(const std::string& s) {
+    return ::b64url_encode(reinterpret_cast<const unsigned char*>(s.data()), s.size());
 }
 
 static int b64_val(char c) {
@@ -60,7 +61,7 @@ static int b64_val(char c) {
     return -1;
 }
 
-static std::string b64url_decode(const std::string& encoded) {
+std::string auth::b64url_decode(const std::string& encoded) {
     // Re-pad
     std::string s = encoded;
     while (s.size() % 4 != 0) s += '=';
@@ -155,7 +156,7 @@ std::string auth::generate_jwt(int user_id, const std::string& username) {
     return signing_input + "." + sig_b64;
 }
 
-std::optional<int> auth::validate_jwt(const std::string& token) {
+static std::optional<int> check_jwt(const std::string& token) {
     // Split into three parts
     auto dot1 = token.find('.');
     if (dot1 == std::string::npos) return std::nullopt;
@@ -172,7 +173,7 @@ std::optional<int> auth::validate_jwt(const std::string& token) {
     if (sig_b64 != expected_sig) return std::nullopt;
 
     // Decode and parse payload
-    std::string payload_json = b64url_decode(payload_b64);
+    std::string payload_json = auth::b64url_decode(payload_b64);
     nlohmann::json j;
     try {
         j = nlohmann::json::parse(payload_json);
@@ -189,6 +190,14 @@ std::optional<int> auth::validate_jwt(const std::string& token) {
     return user_id;
 }
 
+std::optional<int> auth::validate_jwt(const std::string& token) {
+    static metrics::Counter& ok      = metrics::jwt_validations(true);
+    static metrics::Counter& invalid = metrics::jwt_validations(false);
+    auto uid = check_jwt(token);
+    (uid ? ok : invalid).inc();
+    return uid;
+}
+
 std::string auth::bearer_token(const std::string& header) {
     const std::string prefix = "Bearer ";
     if (header.size() <= prefix.size()) return "";
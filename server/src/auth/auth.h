@@ -21,6 +21,11 @@ std::optional<int> validate_jwt(const std::string& token);
 // Returns the raw token string, or empty if malformed.
 std::string bearer_token(const std::string& header);
 
+// Unpadded base64url (RFC 4648 §5), as used in JWTs. Decoding also accepts
+// the standard alphabet and stops at the first invalid character.
+std::string b64url_encode(const std::string& data);
+std::string b64url_decode(const std::string& encoded);
+
 // Set the JWT signing secret at startup (before any tokens are issued).
 void set_secret(std::string secret);
 
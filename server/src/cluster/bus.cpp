@@ -0,0 +1,226 @@
+#include "bus.h"
+#include "wire.h"
+#include "../metrics/metrics.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// Outgoing bytes queued for the broker beyond which publishes are dropped,
+// so a stalled broker cannot grow the node without bound.
+static const size_t MAX_OUTBOX = 64u << 20;
+
+// Reconnect delay, doubled after every failed attempt up to the maximum.
+static const int RETRY_MIN_MS = 100;
+static const int RETRY_MAX_MS = 5000;
+
+namespace {
+
+// Client of norichat_broker. One I/O thread owns the socket; the service
+// thread only touches the queues, under `mutex_`, and pokes the thread
+// through a pipe when it queued the first outgoing frame.
+class BrokerBus : public cluster::Bus {
+public:
+    BrokerBus(std::string address, std::string node, std::function<void()> wake)
+        : address_(std::move(address)), node_(std::move(node)), wake_(std::move(wake)) {}
+
+    ~BrokerBus() override {
+        stop_ = true;
+        poke();
+        if (thread_.joinable()) thread_.join();
+        for (int fd : pipe_) if (fd >= 0) close(fd);
+    }
+
+    bool start() {
+        if (pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) != 0) return false;
+        thread_ = std::thread(&BrokerBus::run, this);
+        return true;
+    }
+
+    void subscribe(const std::string& topic) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (topics_.insert(topic).second && connected_) send_locked('S', topic);
+    }
+
+    void unsubscribe(const std::string& topic) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (topics_.erase(topic) && connected_) send_locked('U', topic);
+    }
+
+    void publish(const std::string& topic, const std::string& payload) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!connected_ || outbox_.size() > MAX_OUTBOX) {
+            metrics::cluster_dropped.inc();
+            return;
+        }
+        send_locked('P', topic, payload);
+        metrics::cluster_published.inc();
+    }
+
+    std::vector<cluster::BusMessage> poll() override {
+        std::vector<cluster::BusMessage> out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(inbox_);
+        return out;
+    }
+
+private:
+    const std::string           address_;
+    const std::string           node_;
+    const std::function<void()> wake_;
+    int                         pipe_[2] = { -1, -1 };
+    std::thread                 thread_;
+    std::atomic<bool>           stop_{false};
+
+    std::mutex                       mutex_;       // guards the members below
+    std::set<std::string>            topics_;      // restored on reconnect
+    std::string                      outbox_;      // frames for the I/O thread
+    std::vector<cluster::BusMessage> inbox_;
+    bool                             connected_ = false;
+
+    void send_locked(char type, const std::string& topic,
+                     const std::string& payload = std::string()) {
+        bool was_empty = outbox_.empty();
+        cluster::wire::append_frame(outbox_, type, topic, payload);
+        if (was_empty) poke();   // else the thread has been poked already
+    }
+
+    void poke() {
+        char c = 0;
+        if (pipe_[1] >= 0 && write(pipe_[1], &c, 1) < 0) { /* full: already poked */ }
+    }
+
+    void deliver(std::vector<cluster::BusMessage>& msgs) {
+        if (msgs.empty()) return;
+        bool was_empty;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            was_empty = inbox_.empty();
+            for (auto& m : msgs) inbox_.push_back(std::move(m));
+        }
+        msgs.clear();
+        if (was_empty) wake_();
+    }
+
+    // Sleep `ms` or until stopped.
+    void wait(int ms) {
+        pollfd p = { pipe_[0], POLLIN, 0 };
+        ::poll(&p, 1, ms);
+        char buf[64];
+        while (read(pipe_[0], buf, sizeof(buf)) > 0) {}
+    }
+
+    void run() {
+        int  retry_ms = RETRY_MIN_MS;
+        bool logged   = false;   // one message per outage, not per attempt
+        while (!stop_) {
+            int fd = cluster::wire::connect_to(address_);
+            if (fd >= 0) {
+                fprintf(stdout, "[cluster] connected to broker %s as %s\n",
+                        address_.c_str(), node_.c_str());
+                retry_ms = RETRY_MIN_MS;
+                logged   = false;
+                serve(fd);
+                close(fd);
+                if (stop_) break;
+                fprintf(stderr, "[cluster] lost connection to broker %s\n", address_.c_str());
+            } else if (!logged) {
+                fprintf(stderr, "[cluster] cannot reach broker %s, retrying\n", address_.c_str());
+                logged = true;
+            }
+            wait(retry_ms);
+            retry_ms = std::min(retry_ms * 2, RETRY_MAX_MS);
+        }
+    }
+
+    // One broker connection, until it fails or the bus is stopped.
+    void serve(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        cluster::wire::set_nodelay(fd);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            outbox_.clear();
+            cluster::wire::append_frame(outbox_, 'H', node_);
+            for (auto& topic : topics_) cluster::wire::append_frame(outbox_, 'S', topic);
+            connected_ = true;
+            inbox_.push_back({ cluster::CONNECTED_TOPIC, std::string() });
+        }
+        metrics::cluster_connected.inc();
+        wake_();
+
+        std::string in, out, topic, payload;
+        size_t      out_pos = 0;
+        std::vector<cluster::BusMessage> received;
+        char        buf[65536];
+        while (!stop_) {
+            if (out_pos == out.size()) {
+                out.clear();
+                out_pos = 0;
+                std::lock_guard<std::mutex> lock(mutex_);
+                out.swap(outbox_);
+            }
+            pollfd fds[2] = {
+                { fd, (short)(POLLIN | (out.empty() ? 0 : POLLOUT)), 0 },
+                { pipe_[0], POLLIN, 0 },
+            };
+            if (::poll(fds, 2, -1) < 0 && errno != EINTR) break;
+            if (fds[1].revents) {
+                while (read(pipe_[0], buf, sizeof(buf)) > 0) {}
+            }
+
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) break;
+                if (n > 0) {
+                    in.append(buf, (size_t)n);
+                    size_t pos = 0;
+                    char   type;
+                    cluster::wire::Parse rc;
+                    while ((rc = cluster::wire::next_frame(in, pos, type, topic, payload)) ==
+                           cluster::wire::Parse::Frame) {
+                        if (type != 'P') continue;
+                        received.push_back({ topic, payload });
+                        metrics::cluster_received.inc();
+                    }
+                    in.erase(0, pos);
+                    deliver(received);
+                    if (rc == cluster::wire::Parse::Bad) {
+                        fprintf(stderr, "[cluster] malformed frame from broker\n");
+                        break;
+                    }
+                }
+            }
+
+            if (out_pos < out.size() && (fds[0].revents & POLLOUT)) {
+                ssize_t n = send(fd, out.data() + out_pos, out.size() - out_pos, MSG_NOSIGNAL);
+                if (n > 0) out_pos += (size_t)n;
+                else if (errno != EAGAIN && errno != EINTR) break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        connected_ = false;
+        outbox_.clear();
+        metrics::cluster_connected.dec();
+    }
+};
+
+} // namespace
+
+std::unique_ptr<cluster::Bus> cluster::connect_broker(const std::string& address,
+                                                      const std::string& node,
+                                                      std::function<void()> wake) {
+    if (!wire::valid_address(address)) return nullptr;
+    auto bus = std::make_unique<BrokerBus>(address, node, std::move(wake));
+    if (!bus->start()) return nullptr;
+    return bus;
+}
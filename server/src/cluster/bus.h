@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cluster {
+
+struct BusMessage {
+    std::string topic;
+    std::string payload;
+};
+
+// Transport between the nodes of a cluster: publish/subscribe by topic.
+// Messages reach every other node subscribed to the topic, at most once and
+// in the order each node published them, never the publisher itself.
+//
+// Methods are called from the lws service thread only. Implementations do
+// their I/O on their own thread, queue what they receive, and call the
+// `wake` callback they were created with whenever poll() has something.
+class Bus {
+public:
+    virtual ~Bus() = default;
+
+    virtual void subscribe(const std::string& topic)   = 0;
+    virtual void unsubscribe(const std::string& topic) = 0;
+    virtual void publish(const std::string& topic, const std::string& payload) = 0;
+
+    // Received messages, oldest first. A message on CONNECTED_TOPIC means the
+    // transport (re)connected: anything published meanwhile may be lost.
+    virtual std::vector<BusMessage> poll() = 0;
+};
+
+constexpr const char* CONNECTED_TOPIC = "$connected";
+
+// Bus through norichat_broker at `address` ("tcp:HOST:PORT" or "unix:PATH"),
+// announcing this node as `node`. Reconnects with backoff and restores the
+// subscriptions. nullptr if the address is malformed.
+std::unique_ptr<Bus> connect_broker(const std::string& address, const std::string& node,
+                                    std::function<void()> wake);
+
+} // namespace cluster
@@ -0,0 +1,84 @@
+#include "cluster.h"
+#include "../db/db.h"
+
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Memberships added on any node, so the others' membership indexes (which
+// scope presence and member lists) stay current. Users and channels need no
+// topic: they are found by the db:: lookups that miss in shared mode.
+static const char* DB_TOPIC = "db.membership";
+
+static std::unique_ptr<cluster::Bus> g_bus;
+static std::string                   g_node;
+static bool                          g_was_connected = false;
+static std::vector<std::pair<std::string, cluster::Handler>> g_handlers;   // prefix → handler
+
+static void publish_membership(int user_id, int server_id) {
+    json msg;
+    msg["user_id"]   = user_id;
+    msg["server_id"] = server_id;
+    cluster::publish(DB_TOPIC, msg.dump());
+}
+
+static void on_membership(const std::string& /*topic*/, const std::string& payload) {
+    json msg = json::parse(payload, nullptr, false);
+    if (!msg.is_object()) return;
+    db::index_membership(msg.value("user_id", 0), msg.value("server_id", 0));
+}
+
+// ─── API ──────────────────────────────────────────────────────────────────────
+
+void cluster::start(std::unique_ptr<Bus> bus, const std::string& node) {
+    g_bus  = std::move(bus);
+    g_node = node;
+    db::set_shared(true);
+    db::set_membership_hook(publish_membership);
+    on(DB_TOPIC, on_membership);
+    subscribe(DB_TOPIC);
+}
+
+void cluster::stop() {
+    db::set_membership_hook(nullptr);
+    g_bus.reset();
+}
+
+bool cluster::enabled() { return g_bus != nullptr; }
+
+const std::string& cluster::node() { return g_node; }
+
+void cluster::subscribe(const std::string& topic) {
+    if (g_bus) g_bus->subscribe(topic);
+}
+
+void cluster::unsubscribe(const std::string& topic) {
+    if (g_bus) g_bus->unsubscribe(topic);
+}
+
+void cluster::publish(const std::string& topic, const std::string& payload) {
+    if (g_bus) g_bus->publish(topic, payload);
+}
+
+void cluster::on(const std::string& prefix, Handler handler) {
+    g_handlers.emplace_back(prefix, handler);
+}
+
+void cluster::drain() {
+    if (!g_bus) return;
+    for (auto& msg : g_bus->poll()) {
+        // Memberships added while the bus was down were never announced
+        if (msg.topic == CONNECTED_TOPIC) {
+            if (g_was_connected) db::reload_membership_index();
+            g_was_connected = true;
+        }
+        for (auto& [prefix, handler] : g_handlers) {
+            if (msg.topic.compare(0, prefix.size(), prefix) != 0) continue;
+            handler(msg.topic, msg.payload);
+            break;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "bus.h"
+
+#include <memory>
+#include <string>
+
+// Cluster mode: several norichat_server processes behind one load balancer,
+// sharing the database and exchanging events over a Bus. This module owns the
+// bus and routes what it receives by topic; ws.cpp decides what to publish.
+// Everything here runs on the lws service thread.
+namespace cluster {
+
+// Called for a message on a topic the handler was registered for.
+using Handler = void (*)(const std::string& topic, const std::string& payload);
+
+// Enable cluster mode with `bus`, this process being `node` (unique in the
+// cluster). Also puts db:: in shared mode and forwards new memberships.
+void start(std::unique_ptr<Bus> bus, const std::string& node);
+void stop();
+
+bool               enabled();
+const std::string& node();
+
+void subscribe(const std::string& topic);
+void unsubscribe(const std::string& topic);
+void publish(const std::string& topic, const std::string& payload);
+
+// Route messages on topics starting with `prefix` to `handler`. The first
+// matching registration wins.
+void on(const std::string& prefix, Handler handler);
+
+// Hand everything the bus received to the handlers. Call from
+// LWS_CALLBACK_EVENT_WAIT_CANCELLED, which the bus triggers.
+void drain();
+
+} // namespace cluster
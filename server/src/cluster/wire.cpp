@@ -0,0 +1,155 @@
+#include "wire.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// ─── Frames ───────────────────────────────────────────────────────────────────
+
+void cluster::wire::append_frame(std::string& out, char type, const std::string& topic,
+                                 const std::string& payload) {
+    uint32_t len = 1 + (uint32_t)topic.size();
+    if (type == 'P') len += 1 + (uint32_t)payload.size();
+    char hdr[5] = { (char)(len >> 24), (char)(len >> 16), (char)(len >> 8), (char)len, type };
+    out.append(hdr, sizeof(hdr));
+    out += topic;
+    if (type == 'P') {
+        out += '\0';
+        out += payload;
+    }
+}
+
+cluster::wire::Parse cluster::wire::next_frame(const std::string& in, size_t& pos, char& type,
+                                               std::string& topic, std::string& payload) {
+    if (in.size() - pos < 4) return Parse::Incomplete;
+    const unsigned char* p = (const unsigned char*)in.data() + pos;
+    uint32_t len = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    if (len == 0 || len > MAX_FRAME) return Parse::Bad;
+    if (in.size() - pos - 4 < len) return Parse::Incomplete;
+
+    const char* body = in.data() + pos + 4;
+    const char* end  = body + len;
+    type = body[0];
+    if (type == 'P') {
+        const char* nul = (const char*)memchr(body + 1, '\0', len - 1);
+        if (!nul) return Parse::Bad;
+        topic.assign(body + 1, nul);
+        payload.assign(nul + 1, end);
+    } else {
+        topic.assign(body + 1, end);
+        payload.clear();
+    }
+    pos += 4 + len;
+    return Parse::Frame;
+}
+
+// ─── Sockets ──────────────────────────────────────────────────────────────────
+
+bool cluster::wire::valid_address(const std::string& address) {
+    if (address.rfind("unix:", 0) == 0) return address.size() > 5;
+    if (address.rfind("tcp:", 0) != 0) return false;
+    size_t colon = address.rfind(':');
+    return colon > 4 && colon + 1 < address.size();
+}
+
+static bool unix_addr(const std::string& path, sockaddr_un& sa) {
+    if (path.size() >= sizeof(sa.sun_path)) {
+        fprintf(stderr, "[cluster] socket path too long: %s\n", path.c_str());
+        return false;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    memcpy(sa.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// getaddrinfo() for "tcp:HOST:PORT"; the caller frees the list.
+static addrinfo* tcp_addrs(const std::string& address, bool passive) {
+    size_t colon = address.rfind(':');
+    std::string host = address.substr(4, colon - 4);
+    std::string port = address.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']')   // IPv6
+        host = host.substr(1, host.size() - 2);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = passive ? AI_PASSIVE : 0;
+    addrinfo* res = nullptr;
+    int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "[cluster] %s: %s\n", address.c_str(), gai_strerror(rc));
+        return nullptr;
+    }
+    return res;
+}
+
+int cluster::wire::connect_to(const std::string& address) {
+    if (!valid_address(address)) return -1;
+    if (address.rfind("unix:", 0) == 0) {
+        sockaddr_un sa;
+        if (!unix_addr(address.substr(5), sa)) return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (sockaddr*)&sa, sizeof(sa)) == 0) return fd;
+        close(fd);
+        return -1;
+    }
+
+    addrinfo* res = tcp_addrs(address, false);
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) { close(fd); fd = -1; }
+    }
+    if (res) freeaddrinfo(res);
+    return fd;
+}
+
+void cluster::wire::set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // fails harmlessly on AF_UNIX
+}
+
+int cluster::wire::listen_on(const std::string& address) {
+    if (!valid_address(address)) {
+        fprintf(stderr, "[cluster] bad address %s (expected tcp:HOST:PORT or unix:PATH)\n",
+                address.c_str());
+        return -1;
+    }
+    if (address.rfind("unix:", 0) == 0) {
+        sockaddr_un sa;
+        if (!unix_addr(address.substr(5), sa)) return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        unlink(sa.sun_path);   // left over from a previous run
+        if (bind(fd, (sockaddr*)&sa, sizeof(sa)) == 0 && listen(fd, 64) == 0) return fd;
+        fprintf(stderr, "[cluster] cannot listen on %s: %s\n", address.c_str(), strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    addrinfo* res = tcp_addrs(address, true);
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 64) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (res) freeaddrinfo(res);
+    if (fd < 0) fprintf(stderr, "[cluster] cannot listen on %s\n", address.c_str());
+    return fd;
+}
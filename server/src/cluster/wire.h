@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Framing and sockets shared by cluster nodes and norichat_broker.
+//
+// Every frame is a 4-byte big-endian body length, then the body:
+//   'H' name                  node → broker   hello: names the node
+//   'S' topic                 node → broker   subscribe
+//   'U' topic                 node → broker   unsubscribe
+//   'P' topic '\0' payload    both ways       publish
+// The broker forwards a publish to every other connection subscribed to its
+// topic, never back to the sender, and publishes the name of a node whose
+// connection closed on DOWN_TOPIC.
+namespace cluster::wire {
+
+constexpr uint32_t    MAX_FRAME  = 16u << 20;
+constexpr const char* DOWN_TOPIC = "$down";
+
+// Append one frame; `payload` is only sent with 'P'.
+void append_frame(std::string& out, char type, const std::string& topic,
+                  const std::string& payload = std::string());
+
+enum class Parse { Frame, Incomplete, Bad };
+
+// Decode the frame starting at `in[pos]` and advance `pos` past it.
+Parse next_frame(const std::string& in, size_t& pos, char& type,
+                 std::string& topic, std::string& payload);
+
+// Sockets for "tcp:HOST:PORT" or "unix:PATH"; -1 with a message on stderr
+// on failure. Both return blocking descriptors with close-on-exec set.
+int connect_to(const std::string& address);
+int listen_on(const std::string& address);
+
+// True if `address` has one of the forms above.
+bool valid_address(const std::string& address);
+
+// Disable Nagle on a connected TCP socket, so small frames (presence, voice
+// signalling) are not held back waiting for an ACK. No-op for unix sockets.
+void set_nodelay(int fd);
+
+} // namespace cluster::wire
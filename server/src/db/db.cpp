@@ -1,16 +1,46 @@
 #include "db.h"
+#include "../metrics/metrics.h"
 #include "../../../shared/protocol/messages.h"
 
 #include <sqlite3.h>
 #include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <unordered_map>
+#include <unordered_set>
 
 // ─── Globals ──────────────────────────────────────────────────────────────────
 
 static sqlite3* g_db = nullptr;
 
+// User directory: every user row, plus a username index, so auth, history and
+// broadcasts resolve names without a query. Loaded by init(), extended by
+// create_user() and, in shared mode, by lookup misses; rows are never
+// updated or deleted.
+static std::unordered_map<int, User>         g_users;
+static std::unordered_map<std::string, int> g_user_ids;   // username → id
+
+// Membership index: mirrors the memberships table and channels.server_id so
+// authorization never hits SQLite. Loaded by init(), kept current by
+// add_membership(), create_channel() and index_membership(). Only touched
+// from the lws service thread, like the connection itself.
+static std::unordered_map<int, std::unordered_set<int>> g_user_servers;
+static std::unordered_map<int, int>                     g_channel_server;
+static uint64_t                                         g_membership_version = 1;
+
+// See set_membership_hook()
+static void (*g_membership_hook)(int user_id, int server_id) = nullptr;
+
+// Set by set_shared(): index misses may be rows another process inserted.
+static bool g_shared = false;
+
+// Records the enclosing db:: function's wall time in norichat_db_seconds.
+#define DB_TIMER(fn)                                                    \
+    static metrics::Histogram& db_latency_ = metrics::db_latency(fn);   \
+    metrics::ScopedTimer db_timer_(db_latency_)
+
 // ─── Schema ───────────────────────────────────────────────────────────────────
 
 static const char* SCHEMA = R"sql(
@@ -45,6 +75,9 @@ CREATE TABLE IF NOT EXISTS messages (
     ts         INTEGER NOT NULL
 );
 
+-- History pages: WHERE channel_id=? AND id<? ORDER BY id DESC
+CREATE INDEX IF NOT EXISTS idx_messages_channel ON messages(channel_id, id);
+
 CREATE TABLE IF NOT EXISTS memberships (
     user_id   INTEGER NOT NULL REFERENCES users(id),
     server_id INTEGER NOT NULL REFERENCES servers(id),
@@ -75,6 +108,83 @@ static sqlite3_stmt* prepare(const char* sql) {
     return stmt;
 }
 
+static User read_user(sqlite3_stmt* st) {
+    User u;
+    u.id            = sqlite3_column_int(st, 0);
+    u.username      = (const char*)sqlite3_column_text(st, 1);
+    u.password_hash = (const char*)sqlite3_column_text(st, 2);
+    u.created_at    = sqlite3_column_int64(st, 3);
+    return u;
+}
+
+static void index_user(const User& u) {
+    g_user_ids[u.username] = u.id;
+    g_users[u.id]          = u;
+}
+
+// Directory entry of `user_id`, read from SQLite on a miss in shared mode.
+static const User* lookup_user(int user_id) {
+    auto it = g_users.find(user_id);
+    if (it != g_users.end()) return &it->second;
+    if (!g_shared) return nullptr;
+
+    sqlite3_stmt* st = prepare(
+        "SELECT id,username,password_hash,created_at FROM users WHERE id=?");
+    if (!st) return nullptr;
+    sqlite3_bind_int(st, 1, user_id);
+    const User* found = nullptr;
+    if (sqlite3_step(st) == SQLITE_ROW) {
+        User u = read_user(st);
+        index_user(u);
+        found = &g_users.at(u.id);
+    }
+    sqlite3_finalize(st);
+    return found;
+}
+
+// Empty if the author is unknown (cannot happen with foreign keys on).
+static std::string username_of(int user_id) {
+    const User* u = lookup_user(user_id);
+    return u ? u->username : std::string();
+}
+
+static bool load_user_directory() {
+    g_users.clear();
+    g_user_ids.clear();
+
+    sqlite3_stmt* st = prepare(
+        "SELECT id,username,password_hash,created_at FROM users");
+    if (!st) return false;
+    while (sqlite3_step(st) == SQLITE_ROW)
+        index_user(read_user(st));
+    sqlite3_finalize(st);
+
+    fprintf(stdout, "[db] user directory: %zu users\n", g_users.size());
+    return true;
+}
+
+static bool load_membership_index() {
+    g_user_servers.clear();
+    g_channel_server.clear();
+    g_membership_version++;
+
+    sqlite3_stmt* st = prepare("SELECT user_id,server_id FROM memberships");
+    if (!st) return false;
+    while (sqlite3_step(st) == SQLITE_ROW)
+        g_user_servers[sqlite3_column_int(st, 0)].insert(sqlite3_column_int(st, 1));
+    sqlite3_finalize(st);
+
+    st = prepare("SELECT id,server_id FROM channels");
+    if (!st) return false;
+    while (sqlite3_step(st) == SQLITE_ROW)
+        g_channel_server[sqlite3_column_int(st, 0)] = sqlite3_column_int(st, 1);
+    sqlite3_finalize(st);
+
+    fprintf(stdout, "[db] membership index: %zu users, %zu channels\n",
+            g_user_servers.size(), g_channel_server.size());
+    return true;
+}
+
 // ─── Init / Close ─────────────────────────────────────────────────────────────
 
 bool db::init(const char* path) {
@@ -82,6 +192,9 @@ bool db::init(const char* path) {
         fprintf(stderr, "[db] cannot open %s: %s\n", path, sqlite3_errmsg(g_db));
         return false;
     }
+    // Cluster nodes share the file: wait for another process's write lock
+    // rather than failing with SQLITE_BUSY
+    sqlite3_busy_timeout(g_db, 2000);
     if (!exec(SCHEMA)) return false;
 
     // Seed: create default server + channel if not present
@@ -98,20 +211,27 @@ bool db::init(const char* path) {
             fprintf(stdout, "[db] seeded default server and channel\n");
         }
     }
-    return true;
+    return load_user_directory() && load_membership_index();
 }
 
+void db::set_shared(bool shared) { g_shared = shared; }
+
 void db::close() {
     if (g_db) {
         sqlite3_close(g_db);
         g_db = nullptr;
     }
+    g_users.clear();
+    g_user_ids.clear();
+    g_user_servers.clear();
+    g_channel_server.clear();
 }
 
 // ─── Users ────────────────────────────────────────────────────────────────────
 
 std::optional<User> db::create_user(const std::string& username,
                                     const std::string& password_hash) {
+    DB_TIMER("create_user");
     sqlite3_stmt* st = prepare(
         "INSERT INTO users(username,password_hash,created_at) VALUES(?,?,?) "
         "RETURNING id,username,password_hash,created_at");
@@ -123,12 +243,8 @@ std::optional<User> db::create_user(const std::string& username,
 
     std::optional<User> result;
     if (sqlite3_step(st) == SQLITE_ROW) {
-        User u;
-        u.id            = sqlite3_column_int(st, 0);
-        u.username      = (const char*)sqlite3_column_text(st, 1);
-        u.password_hash = (const char*)sqlite3_column_text(st, 2);
-        u.created_at    = sqlite3_column_int64(st, 3);
-        result = u;
+        result = read_user(st);
+        index_user(*result);
     } else {
         fprintf(stderr, "[db] create_user: %s\n", sqlite3_errmsg(g_db));
     }
@@ -137,48 +253,40 @@ std::optional<User> db::create_user(const std::string& username,
 }
 
 std::optional<User> db::find_user_by_username(const std::string& username) {
+    auto it = g_user_ids.find(username);
+    if (it != g_user_ids.end()) return g_users.at(it->second);
+    if (!g_shared) return std::nullopt;
+
     sqlite3_stmt* st = prepare(
         "SELECT id,username,password_hash,created_at FROM users WHERE username=?");
     if (!st) return std::nullopt;
-
     sqlite3_bind_text(st, 1, username.c_str(), -1, SQLITE_TRANSIENT);
-
     std::optional<User> result;
     if (sqlite3_step(st) == SQLITE_ROW) {
-        User u;
-        u.id            = sqlite3_column_int(st, 0);
-        u.username      = (const char*)sqlite3_column_text(st, 1);
-        u.password_hash = (const char*)sqlite3_column_text(st, 2);
-        u.created_at    = sqlite3_column_int64(st, 3);
-        result = u;
+        result = read_user(st);
+        index_user(*result);
     }
     sqlite3_finalize(st);
     return result;
 }
 
 std::optional<User> db::find_user_by_id(int id) {
-    sqlite3_stmt* st = prepare(
-        "SELECT id,username,password_hash,created_at FROM users WHERE id=?");
-    if (!st) return std::nullopt;
-
-    sqlite3_bind_int(st, 1, id);
+    const User* u = lookup_user(id);
+    if (!u) return std::nullopt;
+    return *u;
+}
 
-    std::optional<User> result;
-    if (sqlite3_step(st) == SQLITE_ROW) {
-        User u;
-        u.id            = sqlite3_column_int(st, 0);
-        u.username      = (const char*)sqlite3_column_text(st, 1);
-        u.password_hash = (const char*)sqlite3_column_text(st, 2);
-        u.created_at    = sqlite3_column_int64(st, 3);
-        result = u;
-    }
-    sqlite3_finalize(st);
-    return result;
+// g_users is node-based and entries are only ever overwritten in place, so
+// the string outlives rehashing.
+const std::string* db::interned_username(int user_id) {
+    const User* u = lookup_user(user_id);
+    return u ? &u->username : nullptr;
 }
 
 // ─── Servers ──────────────────────────────────────────────────────────────────
 
 std::optional<Server> db::create_server(const std::string& name, int owner_id) {
+    DB_TIMER("create_server");
     sqlite3_stmt* st = prepare(
         "INSERT INTO servers(name,owner_id) VALUES(?,?) "
         "RETURNING id,name,owner_id");
@@ -200,6 +308,7 @@ std::optional<Server> db::create_server(const std::string& name, int owner_id) {
 }
 
 std::vector<Server> db::get_user_servers(int user_id) {
+    DB_TIMER("get_user_servers");
     std::vector<Server> servers;
     sqlite3_stmt* st = prepare(
         "SELECT s.id,s.name,s.owner_id FROM servers s "
@@ -224,6 +333,7 @@ std::vector<Server> db::get_user_servers(int user_id) {
 std::optional<Channel> db::create_channel(int server_id,
                                           const std::string& name,
                                           const std::string& type) {
+    DB_TIMER("create_channel");
     sqlite3_stmt* st = prepare(
         "INSERT INTO channels(server_id,name,type) VALUES(?,?,?) "
         "RETURNING id,server_id,name,type");
@@ -241,12 +351,14 @@ std::optional<Channel> db::create_channel(int server_id,
         c.name      = (const char*)sqlite3_column_text(st, 2);
         c.type      = (const char*)sqlite3_column_text(st, 3);
         result = c;
+        g_channel_server[c.id] = c.server_id;
     }
     sqlite3_finalize(st);
     return result;
 }
 
 std::vector<Channel> db::get_server_channels(int server_id) {
+    DB_TIMER("get_server_channels");
     std::vector<Channel> channels;
     sqlite3_stmt* st = prepare(
         "SELECT id,server_id,name,type FROM channels WHERE server_id=? ORDER BY id");
@@ -268,6 +380,7 @@ std::vector<Channel> db::get_server_channels(int server_id) {
 // ─── Messages ─────────────────────────────────────────────────────────────────
 
 int64_t db::add_message(int channel_id, int author_id, const std::string& content) {
+    DB_TIMER("add_message");
     sqlite3_stmt* st = prepare(
         "INSERT INTO messages(channel_id,author_id,content,ts) VALUES(?,?,?,?) "
         "RETURNING id");
@@ -288,38 +401,47 @@ int64_t db::add_message(int channel_id, int author_id, const std::string& conten
     return id;
 }
 
-std::vector<Message> db::get_messages(int channel_id, int limit) {
+std::vector<Message> db::get_messages(int channel_id, int limit,
+                                      int before_id, int after_id) {
+    DB_TIMER("get_messages");
     std::vector<Message> msgs;
-    sqlite3_stmt* st = prepare(
-        "SELECT m.id,m.channel_id,m.author_id,u.username,m.content,m.ts "
-        "FROM messages m JOIN users u ON u.id=m.author_id "
-        "WHERE m.channel_id=? ORDER BY m.id DESC LIMIT ?");
+    // Newest page (before_id == 0) or the page ending just before before_id
+    // are read newest-first; the page after after_id oldest-first.
+    sqlite3_stmt* st = after_id > 0
+        ? prepare("SELECT id,channel_id,author_id,content,ts FROM messages "
+                  "WHERE channel_id=? AND id>? ORDER BY id ASC LIMIT ?")
+        : prepare("SELECT id,channel_id,author_id,content,ts FROM messages "
+                  "WHERE channel_id=? AND id<? ORDER BY id DESC LIMIT ?");
     if (!st) return msgs;
 
     sqlite3_bind_int(st, 1, channel_id);
-    sqlite3_bind_int(st, 2, limit);
+    if (after_id > 0)
+        sqlite3_bind_int(st, 2, after_id);
+    else
+        sqlite3_bind_int64(st, 2, before_id > 0 ? before_id : INT64_MAX);
+    sqlite3_bind_int(st, 3, limit);
 
     while (sqlite3_step(st) == SQLITE_ROW) {
         Message msg;
         msg.id          = sqlite3_column_int(st, 0);
         msg.channel_id  = sqlite3_column_int(st, 1);
         msg.author_id   = sqlite3_column_int(st, 2);
-        msg.author_name = (const char*)sqlite3_column_text(st, 3);
-        msg.content     = (const char*)sqlite3_column_text(st, 4);
-        msg.ts          = sqlite3_column_int64(st, 5);
+        msg.author_name = username_of(msg.author_id);
+        msg.content     = (const char*)sqlite3_column_text(st, 3);
+        msg.ts          = sqlite3_column_int64(st, 4);
         msgs.push_back(msg);
     }
     sqlite3_finalize(st);
 
     // Return in chronological order
-    std::reverse(msgs.begin(), msgs.end());
+    if (after_id <= 0) std::reverse(msgs.begin(), msgs.end());
     return msgs;
 }
 
 std::optional<Message> db::get_message_by_id(int msg_id) {
+    DB_TIMER("get_message_by_id");
     sqlite3_stmt* st = prepare(
-        "SELECT m.id,m.channel_id,m.author_id,u.username,m.content,m.ts "
-        "FROM messages m JOIN users u ON u.id=m.author_id WHERE m.id=?");
+        "SELECT id,channel_id,author_id,content,ts FROM messages WHERE id=?");
     if (!st) return std::nullopt;
 
     sqlite3_bind_int(st, 1, msg_id);
@@ -330,9 +452,9 @@ std::optional<Message> db::get_message_by_id(int msg_id) {
         m.id          = sqlite3_column_int(st, 0);
         m.channel_id  = sqlite3_column_int(st, 1);
         m.author_id   = sqlite3_column_int(st, 2);
-        m.author_name = (const char*)sqlite3_column_text(st, 3);
-        m.content     = (const char*)sqlite3_column_text(st, 4);
-        m.ts          = sqlite3_column_int64(st, 5);
+        m.author_name = username_of(m.author_id);
+        m.content     = (const char*)sqlite3_column_text(st, 3);
+        m.ts          = sqlite3_column_int64(st, 4);
         result = m;
     }
     sqlite3_finalize(st);
@@ -340,6 +462,7 @@ std::optional<Message> db::get_message_by_id(int msg_id) {
 }
 
 bool db::update_message(int msg_id, int author_id, const std::string& content) {
+    DB_TIMER("update_message");
     sqlite3_stmt* st = prepare(
         "UPDATE messages SET content=? WHERE id=? AND author_id=? "
         "AND (CAST(strftime('%s','now') AS INTEGER) - ts) <= 604800");
@@ -355,6 +478,7 @@ bool db::update_message(int msg_id, int author_id, const std::string& content) {
 }
 
 bool db::delete_message(int msg_id, int author_id) {
+    DB_TIMER("delete_message");
     sqlite3_stmt* st = prepare(
         "DELETE FROM messages WHERE id=? AND author_id=? "
         "AND (CAST(strftime('%s','now') AS INTEGER) - ts) <= 604800");
@@ -371,6 +495,7 @@ bool db::delete_message(int msg_id, int author_id) {
 // ─── Memberships ──────────────────────────────────────────────────────────────
 
 bool db::add_membership(int user_id, int server_id) {
+    DB_TIMER("add_membership");
     sqlite3_stmt* st = prepare(
         "INSERT OR IGNORE INTO memberships(user_id,server_id) VALUES(?,?)");
     if (!st) return false;
@@ -380,37 +505,93 @@ bool db::add_membership(int user_id, int server_id) {
 
     bool ok = (sqlite3_step(st) == SQLITE_DONE);
     sqlite3_finalize(st);
+    if (ok && sqlite3_changes(g_db) > 0) {
+        index_membership(user_id, server_id);
+        if (g_membership_hook) g_membership_hook(user_id, server_id);
+    }
     return ok;
 }
 
+uint64_t db::membership_version() {
+    return g_membership_version;
+}
+
+void db::set_membership_hook(void (*hook)(int, int)) {
+    g_membership_hook = hook;
+}
+
+void db::index_membership(int user_id, int server_id) {
+    if (g_user_servers[user_id].insert(server_id).second)
+        g_membership_version++;
+}
+
+bool db::reload_membership_index() {
+    return load_membership_index();
+}
+
 std::vector<Member> db::get_server_members(int server_id) {
+    DB_TIMER("get_server_members");
     std::vector<Member> members;
-    sqlite3_stmt* st = prepare(
-        "SELECT u.id, u.username FROM users u "
-        "JOIN memberships m ON m.user_id = u.id "
-        "WHERE m.server_id = ? ORDER BY u.username");
+    sqlite3_stmt* st = prepare("SELECT user_id FROM memberships WHERE server_id=?");
     if (!st) return members;
 
     sqlite3_bind_int(st, 1, server_id);
     while (sqlite3_step(st) == SQLITE_ROW) {
         Member m;
         m.id       = sqlite3_column_int(st, 0);
-        m.username = (const char*)sqlite3_column_text(st, 1);
+        m.username = username_of(m.id);
         members.push_back(m);
     }
     sqlite3_finalize(st);
+
+    std::sort(members.begin(), members.end(),
+              [](const Member& a, const Member& b) { return a.username < b.username; });
     return members;
 }
 
 bool db::has_membership(int user_id, int server_id) {
+    auto it = g_user_servers.find(user_id);
+    if (it != g_user_servers.end() && it->second.count(server_id) > 0) return true;
+    if (!g_shared) return false;
+
     sqlite3_stmt* st = prepare(
         "SELECT 1 FROM memberships WHERE user_id=? AND server_id=?");
     if (!st) return false;
-
     sqlite3_bind_int(st, 1, user_id);
     sqlite3_bind_int(st, 2, server_id);
-
     bool found = (sqlite3_step(st) == SQLITE_ROW);
     sqlite3_finalize(st);
+    if (found) index_membership(user_id, server_id);
     return found;
 }
+
+std::vector<int> db::get_user_server_ids(int user_id) {
+    std::vector<int> ids;
+    auto it = g_user_servers.find(user_id);
+    if (it != g_user_servers.end())
+        ids.assign(it->second.begin(), it->second.end());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+int db::get_channel_server(int channel_id) {
+    auto it = g_channel_server.find(channel_id);
+    if (it != g_channel_server.end()) return it->second;
+    if (!g_shared) return -1;
+
+    sqlite3_stmt* st = prepare("SELECT server_id FROM channels WHERE id=?");
+    if (!st) return -1;
+    sqlite3_bind_int(st, 1, channel_id);
+    int server_id = -1;
+    if (sqlite3_step(st) == SQLITE_ROW) {
+        server_id = sqlite3_column_int(st, 0);
+        g_channel_server[channel_id] = server_id;
+    }
+    sqlite3_finalize(st);
+    return server_id;
+}
+
+bool db::can_access_channel(int user_id, int channel_id) {
+    int server_id = get_channel_server(channel_id);
+    return server_id >= 0 && has_membership(user_id, server_id);
+}
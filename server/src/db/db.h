@@ -49,11 +49,19 @@ namespace db {
 bool init(const char* path);
 void close();
 
-// Users
+// Cluster mode: other processes insert rows into the same database. Lookups
+// that miss the in-memory indexes then fall back to SQLite (rows are never
+// updated or deleted, so a hit is never stale).
+void set_shared(bool shared);
+
+// Users – lookups are served from an in-memory directory loaded by init().
 std::optional<User> create_user(const std::string& username,
                                 const std::string& password_hash);
 std::optional<User> find_user_by_username(const std::string& username);
 std::optional<User> find_user_by_id(int id);
+// The name held by the directory, or nullptr for an unknown id. Valid until
+// close(), so callers can keep the pointer rather than a copy.
+const std::string*  interned_username(int user_id);
 
 // Servers
 std::optional<Server> create_server(const std::string& name, int owner_id);
@@ -68,7 +76,10 @@ std::vector<Channel> get_server_channels(int server_id);
 // Messages
 // Returns the new message id, or -1 on error.
 int64_t add_message(int channel_id, int author_id, const std::string& content);
-std::vector<Message>       get_messages(int channel_id, int limit);
+// Up to `limit` messages in chronological order: the newest ones, or the
+// ones just before `before_id` / just after `after_id` when those are > 0.
+std::vector<Message>       get_messages(int channel_id, int limit,
+                                        int before_id = 0, int after_id = 0);
 std::optional<Message>     get_message_by_id(int msg_id);
 // Returns true if the message was updated (author matches, age ≤ 7 days).
 bool update_message(int msg_id, int author_id, const std::string& content);
@@ -77,7 +88,23 @@ bool delete_message(int msg_id, int author_id);
 
 // Memberships
 bool add_membership(int user_id, int server_id);
-bool has_membership(int user_id, int server_id);
 std::vector<Member> get_server_members(int server_id);
+// Changes whenever a membership is added; lets callers cache member lists.
+uint64_t membership_version();
+// Called after add_membership() inserts a row, e.g. to tell other nodes.
+void     set_membership_hook(void (*hook)(int user_id, int server_id));
+// Index a membership another process inserted.
+void     index_membership(int user_id, int server_id);
+// Re-read the whole membership index, e.g. after missing announcements.
+bool     reload_membership_index();
+
+// Authorization – answered from an in-memory index. Only in shared mode does
+// a miss in has_membership() or get_channel_server() (and so in
+// can_access_channel()) query SQLite, for rows another node inserted.
+bool             has_membership(int user_id, int server_id);
+std::vector<int> get_user_server_ids(int user_id);    // sorted
+// Returns the owning server id, or -1 if the channel does not exist.
+int              get_channel_server(int channel_id);
+bool             can_access_channel(int user_id, int channel_id);
 
 } // namespace db
@@ -2,12 +2,16 @@
 #include "ws/ws.h"
 #include "db/db.h"
 #include "auth/auth.h"
+#include "cluster/cluster.h"
 
 #include <libwebsockets.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <csignal>
 #include <cstdlib>
+#include <string>
+#include <unistd.h>
 
 // ─── Globals ──────────────────────────────────────────────────────────────────
 
@@ -15,17 +19,61 @@ static volatile int g_interrupted = 0;
 
 static void sigint_handler(int) { g_interrupted = 1; }
 
+// "R" or "R/B": R per second with bursts of B (default: R, at least 1).
+static bool parse_rate(const char* s, double& per_sec, double& burst) {
+    char* end = nullptr;
+    per_sec = strtod(s, &end);
+    if (end == s || per_sec < 0) return false;
+    burst = per_sec;
+    if (*end == '/') {
+        const char* b = end + 1;
+        burst = strtod(b, &end);
+        if (end == b || burst < 0) return false;
+    }
+    return *end == '\0';
+}
+
 // ─── Entry point ──────────────────────────────────────────────────────────────
 
 int main(int argc, char* argv[]) {
     const char* db_path    = "norichat.db";
     const char* secret_arg = nullptr;
     int         port       = 8080;
+    int         ping_secs  = 30;   // ping a WebSocket quiet for this long
+    int         idle_secs  = 75;   // ... and close any connection quiet for this long
+    const char* cluster_addr = nullptr;   // norichat_broker to join, if any
+    std::string node_name;                // unique per node; default host:port
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--db")     == 0 && i + 1 < argc) db_path    = argv[++i];
         if (strcmp(argv[i], "--port")   == 0 && i + 1 < argc) port       = atoi(argv[++i]);
         if (strcmp(argv[i], "--secret") == 0 && i + 1 < argc) secret_arg = argv[++i];
+        if (strcmp(argv[i], "--ping-interval") == 0 && i + 1 < argc) ping_secs = atoi(argv[++i]);
+        if (strcmp(argv[i], "--idle-timeout")  == 0 && i + 1 < argc) idle_secs = atoi(argv[++i]);
+        if (strcmp(argv[i], "--auth-timeout")  == 0 && i + 1 < argc)
+            ws::set_auth_timeout(atoi(argv[++i]));
+        if (strcmp(argv[i], "--cluster") == 0 && i + 1 < argc) cluster_addr = argv[++i];
+        if (strcmp(argv[i], "--node")    == 0 && i + 1 < argc) node_name    = argv[++i];
+
+        // --rate OP=R[/B] (repeatable) and --conn-rate R[/B]; R 0 = unlimited
+        double per_sec, burst;
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            const char* spec = argv[++i];
+            const char* eq   = strchr(spec, '=');
+            if (!eq || !parse_rate(eq + 1, per_sec, burst) ||
+                !ws::set_rate_limit(std::string(spec, eq - spec), per_sec, burst)) {
+                fprintf(stderr, "[main] bad --rate %s (expected OP=R[/B])\n", spec);
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "--conn-rate") == 0 && i + 1 < argc) {
+            const char* spec = argv[++i];
+            if (!parse_rate(spec, per_sec, burst)) {
+                fprintf(stderr, "[main] bad --conn-rate %s (expected R[/B])\n", spec);
+                return 1;
+            }
+            ws::set_conn_rate_limit(per_sec, burst);
+        }
     }
 
     // ── JWT secret ────────────────────────────────────────────────────────────
@@ -64,6 +112,21 @@ int main(int argc, char* argv[]) {
     info.port      = port;
     info.protocols = protocols;
     info.options   = LWS_SERVER_OPTION_HTTP_HEADERS_SECURITY_BEST_PRACTICES_ENFORCE;
+
+    // ── Heartbeat ─────────────────────────────────────────────────────────────
+    // lws pings a WebSocket that has been quiet for ping_secs and closes any
+    // connection without valid traffic (a pong counts) for idle_secs, so
+    // half-open sessions go through LWS_CALLBACK_CLOSED like a normal
+    // disconnect. --ping-interval 0 turns both off.
+    static lws_retry_bo_t heartbeat;
+    memset(&heartbeat, 0, sizeof(heartbeat));
+    if (ping_secs > 0) {
+        if (idle_secs <= ping_secs) idle_secs = ping_secs * 2;
+        heartbeat.secs_since_valid_ping   = (uint16_t)std::min(ping_secs, 65535);
+        heartbeat.secs_since_valid_hangup = (uint16_t)std::min(idle_secs, 65535);
+        info.retry_and_idle_policy        = &heartbeat;
+    }
+
     // Disable built-in SSL (Phase 1 uses plain ws://)
     info.ssl_cert_filepath        = nullptr;
     info.ssl_private_key_filepath = nullptr;
@@ -78,6 +141,30 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // ── Cluster ───────────────────────────────────────────────────────────────
+    // With --cluster, events for other nodes' sessions go through the broker.
+    // The bus thread wakes the service loop with lws_cancel_service(), which
+    // arrives as LWS_CALLBACK_EVENT_WAIT_CANCELLED and drains the bus there.
+    if (cluster_addr) {
+        if (node_name.empty()) {
+            char host[256] = "node";
+            gethostname(host, sizeof(host) - 1);
+            node_name = std::string(host) + ":" + std::to_string(port);
+        }
+        auto bus = cluster::connect_broker(cluster_addr, node_name,
+                                           [ctx] { lws_cancel_service(ctx); });
+        if (!bus) {
+            fprintf(stderr, "[main] bad --cluster %s (expected tcp:HOST:PORT or unix:PATH)\n",
+                    cluster_addr);
+            lws_context_destroy(ctx);
+            db::close();
+            return 1;
+        }
+        cluster::start(std::move(bus), node_name);
+        ws::join_cluster(ctx);
+        fprintf(stdout, "[main] cluster node %s, broker %s\n", node_name.c_str(), cluster_addr);
+    }
+
     signal(SIGINT,  sigint_handler);
     signal(SIGTERM, sigint_handler);
 
@@ -92,6 +179,7 @@ int main(int argc, char* argv[]) {
     }
 
     fprintf(stdout, "\n[main] shutting down\n");
+    cluster::stop();
     lws_context_destroy(ctx);
     db::close();
     return 0;
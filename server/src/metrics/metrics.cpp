@@ -0,0 +1,242 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+
+// ─── Registry ─────────────────────────────────────────────────────────────────
+// Function-local statics so metrics defined at namespace scope in any
+// translation unit can register themselves during static initialization.
+
+static std::mutex& registry_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+static std::vector<const metrics::Metric*>& registry() {
+    static std::vector<const metrics::Metric*> r;
+    return r;
+}
+
+metrics::Metric::Metric(const char* name, const char* help, const char* type,
+                        std::string labels)
+    : name_(name), help_(help), type_(type), labels_(std::move(labels)) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry().push_back(this);
+}
+
+// Labelled series live here; std::deque keeps references stable.
+template <typename T>
+struct Family {
+    std::deque<T>                  series;
+    std::map<std::string, T*>      by_labels;
+};
+
+// Separate from registry_mutex(): creating a series registers it.
+static std::mutex g_family_mutex;
+
+template <typename T, typename Make>
+static T& series_for(Family<T>& family, const std::string& labels, Make make) {
+    std::lock_guard<std::mutex> lock(g_family_mutex);
+    auto it = family.by_labels.find(labels);
+    if (it != family.by_labels.end()) return *it->second;
+    return *(family.by_labels[labels] = make());
+}
+
+// ─── Sample formatting ────────────────────────────────────────────────────────
+
+static void append_sample(std::string& out, const char* name, const char* suffix,
+                          const std::string& labels, const std::string& extra,
+                          const char* value) {
+    out += name;
+    out += suffix;
+    if (!labels.empty() || !extra.empty()) {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty()) out += ',';
+        out += extra;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+static std::string fmt_u64(uint64_t v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%" PRIu64, v);
+    return buf;
+}
+
+static std::string fmt_double(double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.6g", v);
+    return buf;
+}
+
+// ─── Counter / Gauge ──────────────────────────────────────────────────────────
+
+metrics::Counter::Counter(const char* name, const char* help, std::string labels)
+    : Metric(name, help, "counter", std::move(labels)) {}
+
+void metrics::Counter::render(std::string& out) const {
+    append_sample(out, name(), "", labels(), "",
+                  fmt_u64(value_.load(std::memory_order_relaxed)).c_str());
+}
+
+metrics::Gauge::Gauge(const char* name, const char* help, std::string labels)
+    : Metric(name, help, "gauge", std::move(labels)) {}
+
+void metrics::Gauge::render(std::string& out) const {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%" PRId64, value_.load(std::memory_order_relaxed));
+    append_sample(out, name(), "", labels(), "", buf);
+}
+
+// ─── Histogram ────────────────────────────────────────────────────────────────
+
+metrics::Histogram::Histogram(const char* name, const char* help,
+                              std::vector<uint64_t> bounds, double scale,
+                              std::string labels)
+    : Metric(name, help, "histogram", std::move(labels)),
+      bounds_(std::move(bounds)),
+      scale_(scale),
+      buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    for (size_t i = 0; i <= bounds_.size(); i++)
+        buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+void metrics::Histogram::observe(uint64_t v) {
+    size_t i = std::lower_bound(bounds_.begin(), bounds_.end(), v) - bounds_.begin();
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(v, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics::Histogram::render(std::string& out) const {
+    // Buckets are stored non-cumulative; Prometheus wants cumulative counts.
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= bounds_.size(); i++) {
+        cumulative += buckets_[i].load(std::memory_order_relaxed);
+        std::string le = (i < bounds_.size())
+            ? "le=\"" + fmt_double((double)bounds_[i] * scale_) + "\""
+            : "le=\"+Inf\"";
+        append_sample(out, name(), "_bucket", labels(), le,
+                      fmt_u64(cumulative).c_str());
+    }
+    append_sample(out, name(), "_sum", labels(), "",
+                  fmt_double((double)sum_.load(std::memory_order_relaxed) * scale_).c_str());
+    append_sample(out, name(), "_count", labels(), "",
+                  fmt_u64(count_.load(std::memory_order_relaxed)).c_str());
+}
+
+// ─── Server metrics ───────────────────────────────────────────────────────────
+
+// Microsecond bounds, exported in seconds: 50 µs … 1 s.
+static const std::vector<uint64_t>& latency_buckets() {
+    static const std::vector<uint64_t> b = {
+        50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+        250000, 1000000
+    };
+    return b;
+}
+
+metrics::Gauge metrics::ws_sessions(
+    "norichat_ws_sessions", "Open WebSocket connections.");
+metrics::Gauge metrics::ws_sessions_authed(
+    "norichat_ws_sessions_authed", "Authenticated WebSocket connections.");
+metrics::Gauge metrics::ws_queue_frames(
+    "norichat_ws_write_queue_frames", "Frames waiting in WebSocket write queues.");
+metrics::Gauge metrics::ws_queue_bytes(
+    "norichat_ws_write_queue_bytes", "Payload bytes waiting in WebSocket write queues.");
+metrics::Counter metrics::ws_dropped_frames(
+    "norichat_ws_dropped_frames_total", "Frames that could not be written in full.");
+metrics::Histogram metrics::ws_broadcast_fanout(
+    "norichat_ws_broadcast_fanout", "Recipients per channel or voice broadcast.",
+    {0, 1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000});
+metrics::Gauge metrics::cluster_connected(
+    "norichat_cluster_connected", "1 while connected to the cluster broker.");
+metrics::Counter metrics::cluster_published(
+    "norichat_cluster_published_total", "Messages sent to other cluster nodes.");
+metrics::Counter metrics::cluster_received(
+    "norichat_cluster_received_total", "Messages received from other cluster nodes.");
+metrics::Counter metrics::cluster_dropped(
+    "norichat_cluster_dropped_total",
+    "Outgoing cluster messages lost because the broker was down or backed up.");
+
+metrics::Counter& metrics::ws_op(const std::string& op) {
+    static Family<Counter> family;
+    std::string labels = "op=\"" + op + "\"";
+    return series_for(family, labels, [&] {
+        return &family.series.emplace_back(
+            "norichat_ws_ops_total", "WebSocket messages dispatched, by op.", labels);
+    });
+}
+
+metrics::Counter& metrics::ws_rate_limited(const std::string& op) {
+    static Family<Counter> family;
+    std::string labels = "op=\"" + op + "\"";
+    return series_for(family, labels, [&] {
+        return &family.series.emplace_back(
+            "norichat_ws_rate_limited_total",
+            "WebSocket messages dropped by rate limits, by op.", labels);
+    });
+}
+
+metrics::Counter& metrics::jwt_validations(bool ok) {
+    static Counter valid("norichat_jwt_validations_total",
+                         "JWT validations, by result.", "result=\"ok\"");
+    static Counter invalid("norichat_jwt_validations_total",
+                           "JWT validations, by result.", "result=\"invalid\"");
+    return ok ? valid : invalid;
+}
+
+metrics::Histogram& metrics::db_latency(const std::string& fn) {
+    static Family<Histogram> family;
+    std::string labels = "fn=\"" + fn + "\"";
+    return series_for(family, labels, [&] {
+        return &family.series.emplace_back(
+            "norichat_db_seconds", "SQLite time per db:: function call.",
+            latency_buckets(), 1e-6, labels);
+    });
+}
+
+metrics::Histogram& metrics::http_latency(const std::string& method,
+                                          const std::string& route) {
+    static Family<Histogram> family;
+    std::string labels = "method=\"" + method + "\",route=\"" + route + "\"";
+    return series_for(family, labels, [&] {
+        return &family.series.emplace_back(
+            "norichat_http_request_seconds", "HTTP request handling time, by route.",
+            latency_buckets(), 1e-6, labels);
+    });
+}
+
+// ─── Exposition ───────────────────────────────────────────────────────────────
+
+std::string metrics::render() {
+    std::vector<const Metric*> all;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        all = registry();
+    }
+    // Group series of the same family; HELP/TYPE are written once per family.
+    std::stable_sort(all.begin(), all.end(), [](const Metric* a, const Metric* b) {
+        return std::string(a->name()) < b->name();
+    });
+
+    std::string out;
+    const char* family = "";
+    for (const Metric* m : all) {
+        if (std::string(family) != m->name()) {
+            family = m->name();
+            out += "# HELP "; out += family; out += ' '; out += m->help(); out += '\n';
+            out += "# TYPE "; out += family; out += ' '; out += m->type(); out += '\n';
+        }
+        m->render(out);
+    }
+    return out;
+}
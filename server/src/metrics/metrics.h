@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Process-wide counters exported in the Prometheus text format on /metrics.
+//
+// Updates are a single relaxed atomic add, cheap enough for every hot path.
+// Labelled series are created on first use; callers on hot paths keep the
+// returned reference in a function-local static instead of looking it up
+// again on every call.
+namespace metrics {
+
+// ─── Metric types ─────────────────────────────────────────────────────────────
+
+class Metric {
+public:
+    Metric(const char* name, const char* help, const char* type,
+           std::string labels);
+    virtual ~Metric() = default;
+    Metric(const Metric&)            = delete;
+    Metric& operator=(const Metric&) = delete;
+
+    const char*        name()   const { return name_; }
+    const char*        help()   const { return help_; }
+    const char*        type()   const { return type_; }
+    const std::string& labels() const { return labels_; }   // `k="v",...`
+
+    // Append the sample line(s) of this series.
+    virtual void render(std::string& out) const = 0;
+
+private:
+    const char* name_;
+    const char* help_;
+    const char* type_;
+    std::string labels_;
+};
+
+class Counter : public Metric {
+public:
+    Counter(const char* name, const char* help, std::string labels = "");
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void render(std::string& out) const override;
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge : public Metric {
+public:
+    Gauge(const char* name, const char* help, std::string labels = "");
+    void add(int64_t n)      { value_.fetch_add(n, std::memory_order_relaxed); }
+    void inc()               { add(1); }
+    void dec()               { add(-1); }
+    void render(std::string& out) const override;
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Fixed-bucket histogram over integer observations. `bounds` are inclusive
+// upper bounds in observation units; `scale` converts units to the exported
+// value (e.g. 1e-6 for microseconds exported as seconds).
+class Histogram : public Metric {
+public:
+    Histogram(const char* name, const char* help, std::vector<uint64_t> bounds,
+              double scale = 1.0, std::string labels = "");
+    void observe(uint64_t v);
+    void render(std::string& out) const override;
+
+private:
+    std::vector<uint64_t>                    bounds_;
+    double                                   scale_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;   // bounds_.size() + 1 (+Inf)
+    std::atomic<uint64_t>                    sum_{0};
+    std::atomic<uint64_t>                    count_{0};
+};
+
+// Observes the elapsed wall time in microseconds on destruction.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& h)
+        : hist_(h), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        hist_.observe((uint64_t)us);
+    }
+
+private:
+    Histogram&                            hist_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// ─── Server metrics ───────────────────────────────────────────────────────────
+
+extern Gauge     ws_sessions;          // open WebSocket connections
+extern Gauge     ws_sessions_authed;   // ... of which authenticated
+extern Gauge     ws_queue_frames;      // frames waiting in all write queues
+extern Gauge     ws_queue_bytes;       // payload bytes waiting in all write queues
+extern Counter   ws_dropped_frames;    // frames lws_write() failed to send in full
+extern Histogram ws_broadcast_fanout;  // recipients per channel/voice broadcast
+extern Gauge     cluster_connected;    // 1 while connected to the cluster broker
+extern Counter   cluster_published;    // messages sent to other nodes
+extern Counter   cluster_received;     // messages received from other nodes
+extern Counter   cluster_dropped;      // outgoing messages lost: broker down or backed up
+
+// Per-op WebSocket message counter ("invalid" for unparsable/unknown ops).
+Counter&   ws_op(const std::string& op);
+// Messages dropped by per-session rate limits, by op ("connect" for refused
+// connections).
+Counter&   ws_rate_limited(const std::string& op);
+// JWT validations by outcome ("ok" / "invalid").
+Counter&   jwt_validations(bool ok);
+// Latency of one db:: function that runs SQLite statements.
+Histogram& db_latency(const std::string& fn);
+// Latency of one HTTP route, including response write.
+Histogram& http_latency(const std::string& method, const std::string& route);
+
+// Prometheus text exposition (format 0.0.4) of every registered series.
+std::string render();
+
+} // namespace metrics
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace ws {
+
+// Sorted set of ints for the handful of ids a session holds (subscribed
+// channels, voice channels, servers). Up to INLINE ids are stored in the
+// object itself, so a typical session allocates nothing for them; past that
+// they move to a single heap array. 24 bytes, where an empty std::set is 48
+// plus a 40-byte node per id.
+class IntSet {
+public:
+    static constexpr uint32_t INLINE = 4;
+
+    IntSet() = default;
+    IntSet(const IntSet& o) { assign(o.begin(), o.end()); }
+    IntSet(IntSet&& o) noexcept { steal(o); }
+    IntSet& operator=(const IntSet& o) {
+        if (this != &o) { size_ = 0; assign(o.begin(), o.end()); }
+        return *this;
+    }
+    IntSet& operator=(IntSet&& o) noexcept {
+        if (this != &o) { release(); steal(o); }
+        return *this;
+    }
+    ~IntSet() { release(); }
+
+    // Replace the contents with [first, last), which must be sorted and
+    // free of duplicates.
+    void assign(const int* first, const int* last) {
+        uint32_t n = (uint32_t)(last - first);
+        if (n > cap_) {
+            release();
+            heap_ = new int[n];
+            cap_  = n;
+        }
+        std::memmove(data(), first, n * sizeof(int));
+        size_ = n;
+    }
+
+    const int* begin() const { return data(); }
+    const int* end()   const { return data() + size_; }
+    uint32_t   size()  const { return size_; }
+    bool       empty() const { return size_ == 0; }
+
+    bool contains(int v) const { return std::binary_search(begin(), end(), v); }
+
+    // False if `v` was already present.
+    bool insert(int v) {
+        uint32_t i = (uint32_t)(std::lower_bound(begin(), end(), v) - begin());
+        if (i < size_ && data()[i] == v) return false;
+        if (size_ == cap_) grow();
+        int* d = data();
+        std::memmove(d + i + 1, d + i, (size_ - i) * sizeof(int));
+        d[i] = v;
+        size_++;
+        return true;
+    }
+
+    // False if `v` was not present.
+    bool erase(int v) {
+        uint32_t i = (uint32_t)(std::lower_bound(begin(), end(), v) - begin());
+        if (i == size_ || data()[i] != v) return false;
+        int* d = data();
+        std::memmove(d + i, d + i + 1, (size_ - i - 1) * sizeof(int));
+        size_--;
+        return true;
+    }
+
+    void clear() { release(); }
+
+private:
+    union {
+        int  inline_[INLINE];
+        int* heap_;
+    };
+    uint32_t size_ = 0;
+    uint32_t cap_  = INLINE;   // > INLINE: ids are in heap_
+
+    int*       data()       { return cap_ > INLINE ? heap_ : inline_; }
+    const int* data() const { return cap_ > INLINE ? heap_ : inline_; }
+
+    void grow() {
+        int* p = new int[cap_ * 2];
+        std::memcpy(p, data(), size_ * sizeof(int));
+        uint32_t size = size_;
+        release();
+        heap_ = p;
+        cap_  = size * 2;
+        size_ = size;
+    }
+
+    void release() {
+        if (cap_ > INLINE) delete[] heap_;
+        cap_  = INLINE;
+        size_ = 0;
+    }
+
+    void steal(IntSet& o) {
+        size_ = o.size_;
+        cap_  = o.cap_;
+        if (cap_ > INLINE) heap_ = o.heap_;
+        else               std::memcpy(inline_, o.inline_, sizeof(inline_));
+        o.size_ = 0;
+        o.cap_  = INLINE;
+    }
+};
+
+} // namespace ws
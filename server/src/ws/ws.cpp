@@ -1,25 +1,147 @@
 #include "ws.h"
 #include "../auth/auth.h"
+#include "../cluster/cluster.h"
+#include "../cluster/wire.h"
 #include "../db/db.h"
+#include "../metrics/metrics.h"
 #include "../../../shared/protocol/messages.h"
 
 #include <nlohmann/json.hpp>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 
 using json = nlohmann::json;
 
 // ─── Global session registry ──────────────────────────────────────────────────
 
-static std::map<lws*, ws::Session> g_sessions;
+// Sessions are stored contiguously so broadcasts, which visit every one,
+// walk a single array. A closed session's slot is filled with the last
+// session. g_session_index maps an lws* to its slot: open addressing with
+// linear probing, kept at most half full, so a lookup is usually one probe.
+
+struct SessionSlot {
+    lws*     wsi  = nullptr;   // nullptr = empty
+    uint32_t slot = 0;
+};
+
+static std::vector<ws::Session> g_sessions;
+static std::vector<SessionSlot> g_session_index;   // size is a power of two
+static int                      g_session_index_bits = 0;
+
+static_assert(std::is_nothrow_move_constructible<ws::Session>::value,
+              "g_sessions must move sessions, not copy them");
+
+static size_t index_home(const lws* wsi) {
+    // Fibonacci hashing: spreads the allocator's aligned addresses
+    return (size_t)(((uint64_t)(uintptr_t)wsi * 0x9E3779B97F4A7C15ull) >>
+                    (64 - g_session_index_bits));
+}
+
+static SessionSlot* index_find(const lws* wsi) {
+    if (g_session_index.empty()) return nullptr;
+    size_t mask = g_session_index.size() - 1;
+    for (size_t i = index_home(wsi);; i = (i + 1) & mask) {
+        if (g_session_index[i].wsi == wsi) return &g_session_index[i];
+        if (!g_session_index[i].wsi) return nullptr;
+    }
+}
+
+static void index_insert(lws* wsi, uint32_t slot) {
+    size_t mask = g_session_index.size() - 1;
+    size_t i    = index_home(wsi);
+    while (g_session_index[i].wsi) i = (i + 1) & mask;
+    g_session_index[i] = { wsi, slot };
+}
+
+// Backward-shift deletion: later entries of the probe run move into the
+// hole, so lookups never need tombstones.
+static void index_erase(SessionSlot* entry) {
+    size_t mask = g_session_index.size() - 1;
+    size_t hole = (size_t)(entry - g_session_index.data());
+    for (size_t i = (hole + 1) & mask; g_session_index[i].wsi; i = (i + 1) & mask) {
+        size_t home = index_home(g_session_index[i].wsi);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            g_session_index[hole] = g_session_index[i];
+            hole = i;
+        }
+    }
+    g_session_index[hole] = {};
+}
+
+static void index_rebuild(int bits) {
+    g_session_index_bits = bits;
+    g_session_index.assign((size_t)1 << bits, SessionSlot{});
+    for (uint32_t slot = 0; slot < g_sessions.size(); slot++)
+        index_insert(g_sessions[slot].wsi, slot);
+}
+
+static ws::Session* find_session(const lws* wsi) {
+    SessionSlot* entry = index_find(wsi);
+    return entry ? &g_sessions[entry->slot] : nullptr;
+}
+
+// Invalidates references to other sessions.
+static void add_session(lws* wsi) {
+    g_sessions.emplace_back();
+    g_sessions.back().wsi = wsi;
+    if (g_sessions.size() * 2 > g_session_index.size())
+        index_rebuild(std::max(g_session_index_bits + 1, 6));
+    else
+        index_insert(wsi, (uint32_t)(g_sessions.size() - 1));
+}
+
+// Invalidates references to other sessions.
+static void remove_session(lws* wsi) {
+    SessionSlot* entry = index_find(wsi);
+    if (!entry) return;
+    uint32_t slot = entry->slot;
+    index_erase(entry);
+    if (slot + 1 != g_sessions.size()) {
+        g_sessions[slot] = std::move(g_sessions.back());
+        index_find(g_sessions[slot].wsi)->slot = slot;
+    }
+    g_sessions.pop_back();
+
+    // Give back the memory of a past peak
+    if (g_sessions.capacity() > 64 && g_sessions.size() < g_sessions.capacity() / 4) {
+        g_sessions.shrink_to_fit();
+        if (g_session_index_bits > 6 && g_sessions.size() * 8 < g_session_index.size())
+            index_rebuild(g_session_index_bits - 1);
+    }
+}
+
+// Seconds a connection may stay unauthenticated; lws closes it after that,
+// through LWS_CALLBACK_CLOSED like any other disconnect.
+static int g_auth_timeout_secs = 10;
+
+void ws::set_auth_timeout(int secs) { g_auth_timeout_secs = secs; }
+
+static bool g_log_connections = true;
+
+void ws::set_log_connections(bool on) { g_log_connections = on; }
 
 // ─── Helpers ──────────────────────────────────────────────────────────────────
 
+// Append a frame to `session`'s write queue and request a WRITEABLE callback.
+static void push_frame(lws* wsi, ws::Session& session, const std::string& msg) {
+    session.write_queue.push_back(msg);
+    metrics::ws_queue_frames.inc();
+    metrics::ws_queue_bytes.add((int64_t)msg.size());
+    lws_callback_on_writable(wsi);
+}
+
 // Enqueue a message for delivery and request a WRITEABLE callback.
 static void enqueue(lws* wsi, const std::string& msg) {
-    g_sessions[wsi].write_queue.push_back(msg);
-    lws_callback_on_writable(wsi);
+    if (ws::Session* session = find_session(wsi)) push_frame(wsi, *session, msg);
 }
 
 // Send error JSON to client.
@@ -30,63 +152,700 @@ static void send_error(lws* wsi, const std::string& op, const std::string& msg)
     enqueue(wsi, j.dump());
 }
 
+// True if the two server-id sets have at least one id in common.
+static bool shares_server(const ws::IntSet& a, const ws::IntSet& b) {
+    auto ia = a.begin(), ib = b.begin();
+    while (ia != a.end() && ib != b.end()) {
+        if      (*ia < *ib) ++ia;
+        else if (*ib < *ia) ++ib;
+        else return true;
+    }
+    return false;
+}
+
+// ─── Online registry ──────────────────────────────────────────────────────────
+// One entry per online user, counting its authed sessions (tabs, devices)
+// and, in cluster mode, the other nodes it has sessions on. A user only goes
+// online on the first connection anywhere and offline on the last.
+
+struct OnlineUser {
+    int                connections = 0;         // on this node
+    int                nodes       = 0;         // other nodes
+    const std::string* username    = nullptr;   // interned
+    ws::IntSet         server_ids;
+};
+
+static std::unordered_map<int, OnlineUser> g_online;
+
+// ─── Member list ranges ───────────────────────────────────────────────────────
+// Lazy sessions see a server's member list through a window of rows
+// (MEMBER_LIST_SUBSCRIBE) rather than in full. The list is online members
+// first, each group sorted by username. One index per server is built on
+// first use from db::get_server_members(), patched in place by presence
+// flushes, and rebuilt when memberships change.
+
+struct MemberIndex {
+    uint64_t            version = 0;   // db::membership_version() it reflects
+    std::vector<Member> online;        // sorted by member_before()
+    std::vector<Member> offline;
+};
+
+static std::unordered_map<int, MemberIndex> g_member_index;
+
+static bool member_before(const Member& a, const Member& b) {
+    return a.username != b.username ? a.username < b.username : a.id < b.id;
+}
+
+static MemberIndex& member_index(int server_id) {
+    MemberIndex& idx = g_member_index[server_id];
+    if (idx.version == db::membership_version()) return idx;
+
+    idx.version = db::membership_version();
+    idx.online.clear();
+    idx.offline.clear();
+    for (auto& m : db::get_server_members(server_id))
+        (g_online.count(m.id) ? idx.online : idx.offline).push_back(m);
+    std::sort(idx.online.begin(),  idx.online.end(),  member_before);
+    std::sort(idx.offline.begin(), idx.offline.end(), member_before);
+    return idx;
+}
+
+// Move a user to the online or offline group in the indexes of `server_ids`
+// that exist. Idempotent, so an index built after the change is fine.
+static void member_index_set_online(int user_id, const std::string& username,
+                                    const ws::IntSet& server_ids, bool online) {
+    Member key;
+    key.id       = user_id;
+    key.username = username;
+    for (int sid : server_ids) {
+        auto it = g_member_index.find(sid);
+        if (it == g_member_index.end()) continue;
+        auto& from = online ? it->second.offline : it->second.online;
+        auto& to   = online ? it->second.online  : it->second.offline;
+
+        auto pos = std::lower_bound(from.begin(), from.end(), key, member_before);
+        if (pos != from.end() && pos->id == user_id) from.erase(pos);
+        pos = std::lower_bound(to.begin(), to.end(), key, member_before);
+        if (pos == to.end() || pos->id != user_id) to.insert(pos, key);
+    }
+}
+
+// Send `session` the rows of its window, unless they and the counts are what
+// it was last sent (`force` sends anyway).
+static void send_member_list(lws* wsi, ws::Session& session, bool force) {
+    if (!session.member_list) return;
+    ws::MemberListSub& sub = *session.member_list;
+
+    MemberIndex& idx    = member_index(sub.server_id);
+    int online_count    = (int)idx.online.size();
+    int total           = online_count + (int)idx.offline.size();
+    int end             = std::min(sub.start + sub.count, total);
+    auto row = [&](int r) -> const Member& {
+        return r < online_count ? idx.online[r] : idx.offline[r - online_count];
+    };
+
+    std::vector<int> ids;
+    for (int r = sub.start; r < end; r++) ids.push_back(row(r).id);
+    if (!force && ids == sub.sent_ids &&
+        online_count == sub.sent_online && total == sub.sent_total)
+        return;
+
+    json members = json::array();
+    for (int r = sub.start; r < end; r++) {
+        json o;
+        o["user_id"]  = row(r).id;
+        o["username"] = row(r).username;
+        o["online"]   = r < online_count;
+        members.push_back(o);
+    }
+    json resp;
+    resp["op"]           = OP_MEMBER_LIST;
+    resp["server_id"]    = sub.server_id;
+    resp["start"]        = sub.start;
+    resp["online_count"] = online_count;
+    resp["total"]        = total;
+    resp["members"]      = members;
+    enqueue(wsi, resp.dump());
+
+    sub.sent_ids    = std::move(ids);
+    sub.sent_online = online_count;
+    sub.sent_total  = total;
+}
+
+// ─── Presence ─────────────────────────────────────────────────────────────────
+// Online/offline transitions are not sent one by one. They are collected in
+// g_presence_pending and flushed every PRESENCE_FLUSH_MS as a single
+// PRESENCE_DIFF per recipient, containing only users that share a server with
+// that recipient. A later transition of the same user overwrites the pending
+// one, so a quick reconnect is sent once, as its final state. It is not
+// dropped: a session that authenticated in between saw the intermediate state
+// in its AUTH_OK, and clients treat a repeated online/offline as a no-op.
+// Lazy sessions get no PRESENCE_DIFF; their member-list window is re-sent if
+// it changed.
+
+struct PresenceChange {
+    bool               online   = false;
+    const std::string* username = nullptr;   // interned
+    ws::IntSet         server_ids;
+};
+
+static std::map<int, PresenceChange> g_presence_pending;
+static lws_sorted_usec_list_t        g_presence_sul;
+static bool                          g_presence_scheduled = false;
+
+static void flush_presence(lws_sorted_usec_list_t* /*sul*/) {
+    g_presence_scheduled = false;
+    std::map<int, PresenceChange> pending;
+    pending.swap(g_presence_pending);
+
+    // Bucket changes by server so each recipient only visits its own servers
+    std::map<int, std::vector<const std::pair<const int, PresenceChange>*>> by_server;
+    for (auto& change : pending) {
+        for (int sid : change.second.server_ids)
+            by_server[sid].push_back(&change);
+        member_index_set_online(change.first, *change.second.username,
+                                change.second.server_ids, change.second.online);
+    }
+
+    for (auto& session : g_sessions) {
+        lws* wsi = session.wsi;
+        if (!session.authed) continue;
+        if (session.lazy_members) {
+            if (session.member_list && by_server.count(session.member_list->server_id))
+                send_member_list(wsi, session, false);
+            continue;
+        }
+
+        json online  = json::array();
+        json offline = json::array();
+        std::set<int> seen;
+        for (int sid : session.server_ids) {
+            auto it = by_server.find(sid);
+            if (it == by_server.end()) continue;
+            for (auto* change : it->second) {
+                int uid = change->first;
+                if (uid == session.user_id || !seen.insert(uid).second) continue;
+                if (change->second.online) {
+                    json u;
+                    u["user_id"]  = uid;
+                    u["username"] = *change->second.username;
+                    online.push_back(u);
+                } else {
+                    offline.push_back(uid);
+                }
+            }
+        }
+        if (online.empty() && offline.empty()) continue;
+
+        json diff;
+        diff["op"]      = OP_PRESENCE_DIFF;
+        diff["online"]  = online;
+        diff["offline"] = offline;
+        enqueue(wsi, diff.dump());
+    }
+}
+
+// Record a presence transition, replacing any pending one for the user, and
+// arm the flush timer if it is not running.
+static void queue_presence(lws_context* ctx, int user_id, const OnlineUser& user, bool online) {
+    PresenceChange& change = g_presence_pending[user_id];
+    change.online     = online;
+    change.username   = user.username;
+    change.server_ids = user.server_ids;
+
+    if (!g_presence_scheduled) {
+        g_presence_scheduled = true;
+        lws_sul_schedule(ctx, 0, &g_presence_sul, flush_presence,
+                         PRESENCE_FLUSH_MS * LWS_US_PER_MS);
+    }
+}
+
+// ─── Event sequencing / replay ────────────────────────────────────────────────
+// Every channel event (MESSAGE_NEW/EDITED/DELETED) gets a "seq" from a single
+// monotonic counter, so the stream seen by any one session is strictly
+// increasing. The last REPLAY_RING_SIZE events of each channel are kept so a
+// client that reconnects with RESUME only receives what it missed. `g_epoch`
+// identifies this process's sequence space; after a restart, or on another
+// cluster node, it differs and every resumed channel must be reloaded.
+
+struct ReplayEvent {
+    uint64_t    seq = 0;
+    std::string json;
+};
+
+struct ReplayRing {
+    std::deque<ReplayEvent> events;
+    uint64_t                evicted_seq = 0;   // newest seq dropped from the ring
+};
+
+static uint64_t                                g_event_seq = 0;
+static int64_t                                 g_epoch     = (int64_t)time(nullptr);
+static std::unordered_map<int, ReplayRing>     g_replay;
+
+// Stamp `event` with the next sequence number, remember it for replay and
+// deliver it to the channel's subscribers on this node.
+static void record_channel_event(int channel_id, json& event) {
+    event["seq"] = ++g_event_seq;
+    std::string payload = event.dump();
+
+    ReplayRing& ring = g_replay[channel_id];
+    ring.events.push_back({g_event_seq, payload});
+    if (ring.events.size() > REPLAY_RING_SIZE) {
+        ring.evicted_seq = ring.events.front().seq;
+        ring.events.pop_front();
+    }
+
+    ws::broadcast_to_channel(channel_id, payload);
+}
+
+// ─── Cluster ──────────────────────────────────────────────────────────────────
+// In cluster mode several nodes share the database and exchange events over
+// the cluster bus, on these topics:
+//   ch.<id>       channel events without "seq"; every node stamps them into
+//                 its own sequence and replay ring as if they were local
+//   voice.<id>    VOICE_DATA frames, relayed verbatim
+//   roster.<id>   which users are in a voice channel on which node
+//   presence      users coming online on / going offline from a node
+// A node subscribes to ch.<id> only while one of its sessions is subscribed
+// to the channel, and to voice.<id> / roster.<id> while one is in the voice
+// channel, so the broker forwards that traffic only to nodes that need it.
+
+static lws_context* g_cluster_ctx = nullptr;
+
+static std::string topic_of(const char* prefix, int id) {
+    return prefix + std::to_string(id);
+}
+
+static int topic_id(const std::string& topic) {
+    size_t dot = topic.find('.');
+    return dot == std::string::npos ? 0 : atoi(topic.c_str() + dot + 1);
+}
+
+static void publish_json(const std::string& topic, json& msg) {
+    msg["node"] = cluster::node();
+    cluster::publish(topic, msg.dump());
+}
+
+// ── Channels ──
+
+static std::unordered_map<int, int> g_channel_locals;   // channel → subscribed sessions here
+
+// Events of the channel may be missing from its ring from now on (or were
+// until now): a RESUME from before this point reloads the channel.
+static void mark_replay_gap(int channel_id) {
+    ReplayRing& ring = g_replay[channel_id];
+    ring.evicted_seq = std::max(ring.evicted_seq, g_event_seq + 1);
+}
+
+static void channel_subscribed(int channel_id) {
+    if (g_channel_locals[channel_id]++ > 0 || !cluster::enabled()) return;
+    mark_replay_gap(channel_id);
+    cluster::subscribe(topic_of("ch.", channel_id));
+}
+
+static void channel_unsubscribed(int channel_id) {
+    auto it = g_channel_locals.find(channel_id);
+    if (it == g_channel_locals.end() || --it->second > 0) return;
+    g_channel_locals.erase(it);
+    if (!cluster::enabled()) return;
+    mark_replay_gap(channel_id);
+    cluster::unsubscribe(topic_of("ch.", channel_id));
+}
+
+// A channel event that happened on this node: tell the other nodes, then
+// record and deliver it here.
+static void publish_channel_event(int channel_id, json& event) {
+    if (cluster::enabled()) cluster::publish(topic_of("ch.", channel_id), event.dump());
+    record_channel_event(channel_id, event);
+}
+
+static void on_channel_topic(const std::string& topic, const std::string& payload) {
+    json event = json::parse(payload, nullptr, false);
+    if (event.is_object()) record_channel_event(topic_id(topic), event);
+}
+
+// ── Voice ──
+
+static std::string voice_joined_json(int channel_id, int user_id, const std::string& username) {
+    json j;
+    j["op"]         = OP_VOICE_JOINED;
+    j["channel_id"] = channel_id;
+    j["user_id"]    = user_id;
+    j["username"]   = username;
+    return j.dump();
+}
+
+static std::string voice_left_json(int channel_id, int user_id) {
+    json j;
+    j["op"]         = OP_VOICE_LEFT;
+    j["channel_id"] = channel_id;
+    j["user_id"]    = user_id;
+    return j.dump();
+}
+
+// Users in a voice channel through another node, for VOICE_JOIN_OK. Only
+// kept for channels with a session here, the only ones whose roster.<id>
+// this node hears.
+struct RemoteVoice {
+    std::string node;
+    int         user_id  = 0;
+    int         sessions = 0;
+};
+
+static std::unordered_map<int, int>                      g_voice_locals;   // channel → sessions here
+static std::unordered_map<int, std::vector<RemoteVoice>> g_voice_remote;
+
+// Set how many sessions `node` has in the voice channel for `user_id`; local
+// sessions see VOICE_JOINED / VOICE_LEFT when that becomes non-zero / zero.
+static void set_remote_voice(int channel_id, const std::string& node, int user_id, int sessions) {
+    auto& list = g_voice_remote[channel_id];
+    auto it = std::find_if(list.begin(), list.end(), [&](const RemoteVoice& r) {
+        return r.user_id == user_id && r.node == node;
+    });
+    if (it == list.end()) {
+        if (sessions <= 0) return;
+        list.push_back({node, user_id, sessions});
+        const std::string* name = db::interned_username(user_id);
+        ws::broadcast_to_voice(channel_id, voice_joined_json(channel_id, user_id, name ? *name : "?"));
+    } else if (sessions > 0) {
+        it->sessions = sessions;
+    } else {
+        list.erase(it);
+        ws::broadcast_to_voice(channel_id, voice_left_json(channel_id, user_id));
+    }
+}
+
+static int remote_voice_sessions(int channel_id, const std::string& node, int user_id) {
+    for (auto& r : g_voice_remote[channel_id])
+        if (r.user_id == user_id && r.node == node) return r.sessions;
+    return 0;
+}
+
+// Tell the channel's other nodes about every session here in it.
+static void publish_voice_here(int channel_id) {
+    json users = json::array();
+    for (auto& session : g_sessions)
+        if (session.authed && session.voice_channels.contains(channel_id))
+            users.push_back(session.user_id);
+    json msg;
+    msg["t"]     = "here";
+    msg["users"] = users;
+    publish_json(topic_of("roster.", channel_id), msg);
+}
+
+// A session here joined / left the voice channel.
+static void voice_entered(int channel_id, int user_id) {
+    bool first = (g_voice_locals[channel_id]++ == 0);
+    if (!cluster::enabled()) return;
+    if (first) {
+        cluster::subscribe(topic_of("voice.", channel_id));
+        cluster::subscribe(topic_of("roster.", channel_id));
+        json who;
+        who["t"] = "who";
+        publish_json(topic_of("roster.", channel_id), who);
+    }
+    json msg;
+    msg["t"]       = "join";
+    msg["user_id"] = user_id;
+    publish_json(topic_of("roster.", channel_id), msg);
+}
+
+static void voice_exited(int channel_id, int user_id) {
+    auto it = g_voice_locals.find(channel_id);
+    if (it == g_voice_locals.end()) return;
+    bool last = (--it->second == 0);
+    if (last) g_voice_locals.erase(it);
+    if (!cluster::enabled()) return;
+
+    json msg;
+    msg["t"]       = "leave";
+    msg["user_id"] = user_id;
+    publish_json(topic_of("roster.", channel_id), msg);
+    if (last) {
+        cluster::unsubscribe(topic_of("voice.", channel_id));
+        cluster::unsubscribe(topic_of("roster.", channel_id));
+        g_voice_remote.erase(channel_id);
+    }
+}
+
+static void on_voice_topic(const std::string& topic, const std::string& payload) {
+    int channel_id = topic_id(topic);
+    if (g_voice_locals.count(channel_id)) ws::broadcast_to_voice(channel_id, payload);
+}
+
+static void on_roster_topic(const std::string& topic, const std::string& payload) {
+    int channel_id = topic_id(topic);
+    if (!g_voice_locals.count(channel_id)) return;   // left since; in flight
+    json msg = json::parse(payload, nullptr, false);
+    if (!msg.is_object()) return;
+    std::string t    = msg.value("t", "");
+    std::string node = msg.value("node", "");
+    int         uid  = msg.value("user_id", 0);
+
+    if (t == "who") {
+        publish_voice_here(channel_id);
+    } else if (t == "here") {
+        // The node's complete list: replaces what was known about it
+        std::map<int, int> counts;
+        if (msg.contains("users") && msg["users"].is_array())
+            for (auto& v : msg["users"])
+                if (v.is_number_integer()) counts[v.get<int>()]++;
+        std::vector<int> gone;
+        for (auto& r : g_voice_remote[channel_id])
+            if (r.node == node && !counts.count(r.user_id)) gone.push_back(r.user_id);
+        for (int user_id : gone) set_remote_voice(channel_id, node, user_id, 0);
+        for (auto& [user_id, n] : counts) set_remote_voice(channel_id, node, user_id, n);
+    } else if (t == "join") {
+        set_remote_voice(channel_id, node, uid, remote_voice_sessions(channel_id, node, uid) + 1);
+    } else if (t == "leave") {
+        set_remote_voice(channel_id, node, uid, remote_voice_sessions(channel_id, node, uid) - 1);
+    }
+}
+
+// ── Presence ──
+
+static std::unordered_map<std::string, std::unordered_set<int>> g_remote_online;   // node → users
+
+// A user's first session on this node opened / last one closed.
+static void publish_presence(const char* t, const json& user_ids) {
+    if (!cluster::enabled()) return;
+    json msg;
+    msg["t"]        = t;
+    msg["user_ids"] = user_ids;
+    publish_json("presence", msg);
+}
+
+// Announce every user with a session here, for nodes that (re)joined.
+static void publish_local_users() {
+    json ids = json::array();
+    for (auto& [user_id, entry] : g_online)
+        if (entry.connections > 0) ids.push_back(user_id);
+    if (!ids.empty()) publish_presence("online", ids);
+}
+
+static void remote_online(int user_id) {
+    OnlineUser& entry = g_online[user_id];
+    if (!entry.username) {
+        entry.username = db::interned_username(user_id);
+        if (!entry.username) { g_online.erase(user_id); return; }
+        std::vector<int> ids = db::get_user_server_ids(user_id);
+        entry.server_ids.assign(ids.data(), ids.data() + ids.size());
+    }
+    if (entry.nodes++ == 0 && entry.connections == 0)
+        queue_presence(g_cluster_ctx, user_id, entry, true);
+}
+
+static void remote_offline(int user_id) {
+    auto it = g_online.find(user_id);
+    if (it == g_online.end() || --it->second.nodes > 0 || it->second.connections > 0) return;
+    queue_presence(g_cluster_ctx, user_id, it->second, false);
+    g_online.erase(it);
+}
+
+static void on_presence_topic(const std::string& /*topic*/, const std::string& payload) {
+    json msg = json::parse(payload, nullptr, false);
+    if (!msg.is_object()) return;
+    std::string t    = msg.value("t", "");
+    std::string node = msg.value("node", "");
+    if (node.empty() || node == cluster::node()) return;
+
+    if (t == "sync") {   // a node (re)joined: it needs everyone's users
+        publish_local_users();
+        return;
+    }
+    if (!msg.contains("user_ids") || !msg["user_ids"].is_array()) return;
+    auto& users = g_remote_online[node];
+    for (auto& v : msg["user_ids"]) {
+        if (!v.is_number_integer()) continue;
+        int user_id = v.get<int>();
+        if (t == "online" && users.insert(user_id).second) remote_online(user_id);
+        if (t == "offline" && users.erase(user_id))        remote_offline(user_id);
+    }
+    if (users.empty()) g_remote_online.erase(node);
+}
+
+// ── Membership of the cluster ──
+
+// Everything known about `node`'s sessions is void: it went down.
+static void forget_node(const std::string& node) {
+    auto it = g_remote_online.find(node);
+    if (it != g_remote_online.end()) {
+        for (int user_id : it->second) remote_offline(user_id);
+        g_remote_online.erase(it);
+    }
+    for (auto& [channel_id, list] : g_voice_remote) {
+        std::vector<int> gone;
+        for (auto& r : list)
+            if (r.node == node) gone.push_back(r.user_id);
+        for (int user_id : gone) set_remote_voice(channel_id, node, user_id, 0);
+    }
+}
+
+static void on_node_down(const std::string& /*topic*/, const std::string& payload) {
+    fprintf(stdout, "[cluster] node %s left\n", payload.c_str());
+    forget_node(payload);
+}
+
+// The bus (re)connected. Anything may have been missed meanwhile, so drop
+// all remote state and rebuild it from the other nodes' answers.
+static void on_connected(const std::string& /*topic*/, const std::string& /*payload*/) {
+    std::vector<std::string> nodes;
+    for (auto& [node, users] : g_remote_online) nodes.push_back(node);
+    for (auto& [channel_id, list] : g_voice_remote)
+        for (auto& r : list) nodes.push_back(r.node);
+    for (auto& node : nodes) forget_node(node);
+
+    for (auto& [channel_id, n] : g_channel_locals) mark_replay_gap(channel_id);
+
+    json sync;
+    sync["t"] = "sync";
+    publish_json("presence", sync);
+    publish_local_users();
+
+    for (auto& [channel_id, n] : g_voice_locals) {
+        json who;
+        who["t"] = "who";
+        publish_json(topic_of("roster.", channel_id), who);
+        publish_voice_here(channel_id);
+    }
+}
+
+void ws::join_cluster(lws_context* ctx) {
+    g_cluster_ctx = ctx;
+    // Sequence spaces of nodes started in the same second must differ too
+    g_epoch ^= (int64_t)(std::hash<std::string>{}(cluster::node()) & 0x7FFFFFFF) << 32;
+
+    cluster::on("ch.",      on_channel_topic);
+    cluster::on("voice.",   on_voice_topic);
+    cluster::on("roster.",  on_roster_topic);
+    cluster::on("presence", on_presence_topic);
+    cluster::on(cluster::wire::DOWN_TOPIC, on_node_down);
+    cluster::on(cluster::CONNECTED_TOPIC,  on_connected);
+    cluster::subscribe("presence");
+    cluster::subscribe(cluster::wire::DOWN_TOPIC);
+}
+
 // ─── Message handlers ─────────────────────────────────────────────────────────
 
-static void handle_auth(lws* wsi, ws::Session& session, const json& msg) {
-    std::string token = msg.value("token", "");
-    auto uid = auth::validate_jwt(token);
+// Validate `token` and bind the session to its user. On success the user is
+// registered online and the AUTH_OK-style fields are written to `resp`.
+static bool authenticate(lws* wsi, ws::Session& session,
+                         const json& msg, json& resp) {
+    if (session.authed) {
+        send_error(wsi, OP_ERROR, "already authenticated");
+        return false;
+    }
+    auto uid = auth::validate_jwt(msg.value("token", ""));
     if (!uid) {
         send_error(wsi, OP_AUTH_FAIL, "invalid or expired token");
-        return;
+        return false;
     }
     auto user = db::find_user_by_id(*uid);
     if (!user) {
         send_error(wsi, OP_AUTH_FAIL, "user not found");
-        return;
+        return false;
     }
-    session.user_id  = user->id;
-    session.username = user->username;
-    session.authed   = true;
-
-    // Build list of currently online users for the new client
-    json online_list = json::array();
-    for (auto& [other_wsi, other_sess] : g_sessions) {
-        if (other_sess.authed && other_wsi != wsi) {
-            json u;
-            u["user_id"]  = other_sess.user_id;
-            u["username"] = other_sess.username;
-            online_list.push_back(u);
+    lws_set_timeout(wsi, NO_PENDING_TIMEOUT, 0);   // the auth timeout
+    session.user_id      = user->id;
+    session.username     = db::interned_username(user->id);
+    session.authed       = true;
+    session.lazy_members = msg.value("lazy_members", false);
+    metrics::ws_sessions_authed.inc();
+    std::vector<int> server_ids = db::get_user_server_ids(user->id);
+    session.server_ids.assign(server_ids.data(), server_ids.data() + server_ids.size());
+
+    // Build list of currently online users that share a server with the new
+    // client; lazy clients ask for member-list windows instead
+    if (!session.lazy_members) {
+        json online_list = json::array();
+        for (auto& [other_id, other] : g_online) {
+            if (other_id != user->id &&
+                shares_server(session.server_ids, other.server_ids)) {
+                json u;
+                u["user_id"]  = other_id;
+                u["username"] = *other.username;
+                online_list.push_back(u);
+            }
         }
+        resp["online"] = online_list;
     }
 
-    json resp;
-    resp["op"]       = OP_AUTH_OK;
     resp["user_id"]  = user->id;
     resp["username"] = user->username;
-    resp["online"]   = online_list;
+    resp["epoch"]    = g_epoch;
+    resp["seq"]      = g_event_seq;
+
+    OnlineUser& entry = g_online[user->id];
+    entry.username   = session.username;
+    entry.server_ids = session.server_ids;
+    if (entry.connections++ == 0) {
+        if (entry.nodes == 0) queue_presence(lws_get_context(wsi), user->id, entry, true);
+        publish_presence("online", json::array({user->id}));
+    }
+    return true;
+}
+
+static void handle_auth(lws* wsi, ws::Session& session, const json& msg) {
+    json resp;
+    if (!authenticate(wsi, session, msg, resp)) return;
+    resp["op"] = OP_AUTH_OK;
     enqueue(wsi, resp.dump());
+}
+
+// Re-authenticate after a reconnect, resubscribe the given channels and replay
+// the channel events newer than `last_seq`. Channels whose ring no longer
+// covers the gap are listed in "reload" so the client refetches only those.
+static void handle_resume(lws* wsi, ws::Session& session, const json& msg) {
+    json resp;
+    if (!authenticate(wsi, session, msg, resp)) return;
+
+    int64_t  epoch    = msg.value("epoch", (int64_t)0);
+    uint64_t last_seq = msg.value("last_seq", (uint64_t)0);
+    bool same_stream  = (epoch == g_epoch && last_seq <= g_event_seq);
+
+    json reload = json::array();
+    std::vector<const ReplayEvent*> missed;
+    if (msg.contains("channels") && msg["channels"].is_array()) {
+        for (auto& v : msg["channels"]) {
+            int channel_id = v.is_number_integer() ? v.get<int>() : 0;
+            if (!db::can_access_channel(session.user_id, channel_id)) continue;
+            if (session.subscribed_channels.insert(channel_id)) channel_subscribed(channel_id);
 
-    // Notify all other authed sessions that this user came online
-    json notify;
-    notify["op"]       = OP_USER_ONLINE;
-    notify["user_id"]  = user->id;
-    notify["username"] = user->username;
-    std::string notify_json = notify.dump();
-    for (auto& [other_wsi, other_sess] : g_sessions) {
-        if (other_sess.authed && other_wsi != wsi)
-            enqueue(other_wsi, notify_json);
+            auto it = g_replay.find(channel_id);
+            if (!same_stream ||
+                (it != g_replay.end() && it->second.evicted_seq > last_seq)) {
+                reload.push_back(channel_id);
+                continue;
+            }
+            if (it == g_replay.end()) continue;
+            for (auto& ev : it->second.events)
+                if (ev.seq > last_seq) missed.push_back(&ev);
+        }
     }
+
+    resp["op"]     = OP_RESUMED;
+    resp["reload"] = reload;
+    enqueue(wsi, resp.dump());
+
+    std::sort(missed.begin(), missed.end(),
+              [](const ReplayEvent* a, const ReplayEvent* b) { return a->seq < b->seq; });
+    for (auto* ev : missed)
+        enqueue(wsi, ev->json);
 }
 
 static void handle_channel_join(lws* wsi, ws::Session& session, const json& msg) {
     int channel_id = msg.value("channel_id", 0);
     if (channel_id <= 0) { send_error(wsi, OP_ERROR, "invalid channel_id"); return; }
-    session.subscribed_channels.insert(channel_id);
+    if (!db::can_access_channel(session.user_id, channel_id)) {
+        send_error(wsi, OP_ERROR, "not a member of this server");
+        return;
+    }
+    if (session.subscribed_channels.insert(channel_id)) channel_subscribed(channel_id);
 }
 
 static void handle_channel_leave(lws* /*wsi*/, ws::Session& session, const json& msg) {
     int channel_id = msg.value("channel_id", 0);
-    session.subscribed_channels.erase(channel_id);
+    if (session.subscribed_channels.erase(channel_id)) channel_unsubscribed(channel_id);
 }
 
 static void handle_message_send(lws* wsi, ws::Session& session, const json& msg) {
@@ -97,6 +856,10 @@ static void handle_message_send(lws* wsi, ws::Session& session, const json& msg)
         send_error(wsi, OP_ERROR, "invalid channel_id or empty content");
         return;
     }
+    if (!db::can_access_channel(session.user_id, channel_id)) {
+        send_error(wsi, OP_ERROR, "not a member of this server");
+        return;
+    }
     if (content.size() > MAX_MSG_LEN) content.resize(MAX_MSG_LEN);
 
     int64_t new_id = db::add_message(channel_id, session.user_id, content);
@@ -110,11 +873,11 @@ static void handle_message_send(lws* wsi, ws::Session& session, const json& msg)
     broadcast["id"]         = new_id;
     broadcast["channel_id"] = channel_id;
     broadcast["author_id"]  = session.user_id;
-    broadcast["author"]     = session.username;
+    broadcast["author"]     = *session.username;
     broadcast["content"]    = content;
     broadcast["ts"]         = (int64_t)time(nullptr);
 
-    ws::broadcast_to_channel(channel_id, broadcast.dump());
+    publish_channel_event(channel_id, broadcast);
 }
 
 static void handle_message_edit(lws* wsi, ws::Session& session, const json& msg) {
@@ -141,7 +904,7 @@ static void handle_message_edit(lws* wsi, ws::Session& session, const json& msg)
     bcast["message_id"] = msg_id;
     bcast["channel_id"] = orig->channel_id;
     bcast["content"]    = content;
-    ws::broadcast_to_channel(orig->channel_id, bcast.dump());
+    publish_channel_event(orig->channel_id, bcast);
 }
 
 static void handle_message_delete(lws* wsi, ws::Session& session, const json& msg) {
@@ -164,7 +927,35 @@ static void handle_message_delete(lws* wsi, ws::Session& session, const json& ms
     bcast["op"]         = OP_MESSAGE_DELETED;
     bcast["message_id"] = msg_id;
     bcast["channel_id"] = orig->channel_id;
-    ws::broadcast_to_channel(orig->channel_id, bcast.dump());
+    publish_channel_event(orig->channel_id, bcast);
+}
+
+// ─── Member list handler ──────────────────────────────────────────────────────
+
+// Subscribe to rows [start, start+count) of a server's member list; replaces
+// any previous window. count 0 unsubscribes.
+static void handle_member_list_subscribe(lws* wsi, ws::Session& session, const json& msg) {
+    int server_id = msg.value("server_id", 0);
+    int start     = msg.value("start", 0);
+    int count     = msg.value("count", 0);
+    if (count <= 0) {
+        session.member_list.reset();
+        return;
+    }
+    if (server_id <= 0 || start < 0) {
+        send_error(wsi, OP_ERROR, "invalid member range");
+        return;
+    }
+    if (!db::has_membership(session.user_id, server_id)) {
+        send_error(wsi, OP_ERROR, "not a member of this server");
+        return;
+    }
+    if (!session.member_list) session.member_list = std::make_unique<ws::MemberListSub>();
+    ws::MemberListSub& sub = *session.member_list;
+    sub.server_id = server_id;
+    sub.start     = start;
+    sub.count     = std::min(count, MEMBER_RANGE_MAX);
+    send_member_list(wsi, session, true);
 }
 
 // ─── Voice handlers ───────────────────────────────────────────────────────────
@@ -172,17 +963,31 @@ static void handle_message_delete(lws* wsi, ws::Session& session, const json& ms
 static void handle_voice_join(lws* wsi, ws::Session& session, const json& msg) {
     int channel_id = msg.value("channel_id", 0);
     if (channel_id <= 0) { send_error(wsi, OP_ERROR, "invalid channel_id"); return; }
+    if (!db::can_access_channel(session.user_id, channel_id)) {
+        send_error(wsi, OP_ERROR, "not a member of this server");
+        return;
+    }
 
-    session.voice_channels.insert(channel_id);
+    if (session.voice_channels.insert(channel_id)) voice_entered(channel_id, session.user_id);
 
     // Build current participant list for the joining client
     json participants = json::array();
-    for (auto& [other_wsi, other_sess] : g_sessions) {
-        if (other_sess.authed && other_wsi != wsi &&
-            other_sess.voice_channels.count(channel_id)) {
+    for (auto& other : g_sessions) {
+        if (other.authed && other.wsi != wsi &&
+            other.voice_channels.contains(channel_id)) {
             json p;
-            p["user_id"]  = other_sess.user_id;
-            p["username"] = other_sess.username;
+            p["user_id"]  = other.user_id;
+            p["username"] = *other.username;
+            participants.push_back(p);
+        }
+    }
+    auto remote = g_voice_remote.find(channel_id);
+    if (remote != g_voice_remote.end()) {
+        for (auto& r : remote->second) {
+            const std::string* name = db::interned_username(r.user_id);
+            json p;
+            p["user_id"]  = r.user_id;
+            p["username"] = name ? *name : "?";
             participants.push_back(p);
         }
     }
@@ -192,68 +997,186 @@ static void handle_voice_join(lws* wsi, ws::Session& session, const json& msg) {
     ok["participants"] = participants;
     enqueue(wsi, ok.dump());
 
-    // Notify others already in voice that a new participant joined
-    json notify;
-    notify["op"]         = OP_VOICE_JOINED;
-    notify["channel_id"] = channel_id;
-    notify["user_id"]    = session.user_id;
-    notify["username"]   = session.username;
-    ws::broadcast_to_voice(channel_id, notify.dump(), wsi);
+    // Notify others already in voice that a new participant joined (other
+    // nodes do the same for theirs from the roster)
+    ws::broadcast_to_voice(channel_id,
+                           voice_joined_json(channel_id, session.user_id, *session.username), wsi);
 }
 
 static void handle_voice_leave(lws* wsi, ws::Session& session, const json& msg) {
     int channel_id = msg.value("channel_id", 0);
-    session.voice_channels.erase(channel_id);
-
-    json notify;
-    notify["op"]         = OP_VOICE_LEFT;
-    notify["channel_id"] = channel_id;
-    notify["user_id"]    = session.user_id;
-    ws::broadcast_to_voice(channel_id, notify.dump(), wsi);
+    if (session.voice_channels.erase(channel_id)) voice_exited(channel_id, session.user_id);
+    ws::broadcast_to_voice(channel_id, voice_left_json(channel_id, session.user_id), wsi);
 }
 
 static void handle_voice_data(lws* wsi, ws::Session& session, const json& msg) {
     int channel_id = msg.value("channel_id", 0);
     std::string data = msg.value("data", "");
     if (channel_id <= 0 || data.empty()) return;
-    if (!session.voice_channels.count(channel_id)) return; // must have joined first
+    if (!session.voice_channels.contains(channel_id)) return; // must have joined first
 
     json relay;
     relay["op"]         = OP_VOICE_DATA;
     relay["channel_id"] = channel_id;
     relay["user_id"]    = session.user_id;
     relay["data"]       = data;
-    ws::broadcast_to_voice(channel_id, relay.dump(), wsi); // relay to all other participants
+    std::string payload = relay.dump();
+    ws::broadcast_to_voice(channel_id, payload, wsi); // relay to all other participants
+    if (cluster::enabled()) cluster::publish(topic_of("voice.", channel_id), payload);
 }
 
-static void dispatch(lws* wsi, ws::Session& session, const std::string& raw) {
+// ─── Rate limiting ────────────────────────────────────────────────────────────
+// Token buckets, refilled from the elapsed time when a message arrives, so
+// idle sessions cost nothing. Time is a 32-bit millisecond clock; unsigned
+// subtraction keeps it right across wrap-around.
+
+struct RateLimit {
+    float per_sec;   // 0 = unlimited
+    float burst;
+};
+
+static uint32_t now_ms() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+// Take one token if there is one.
+static bool take_token(ws::RateBucket& b, const RateLimit& lim, uint32_t now) {
+    if (lim.per_sec <= 0.f) return true;
+    if (b.tokens < 0.f)
+        b.tokens = lim.burst;
+    else
+        b.tokens = std::min(lim.burst, b.tokens + (now - b.last_ms) * lim.per_sec * 1e-3f);
+    b.last_ms = now;
+    if (b.tokens < 1.f) return false;
+    b.tokens -= 1.f;
+    return true;
+}
+
+// New connections per peer IP. Peers whose bucket has refilled are dropped
+// from the table once it grows past CONN_TABLE_MAX: they would start full anyway.
+static const size_t CONN_TABLE_MAX = 4096;
+static RateLimit    g_conn_limit   = { 10.f, 50.f };
+static std::unordered_map<std::string, ws::RateBucket> g_conn_buckets;
+
+static bool accept_connection(const std::string& ip) {
+    if (g_conn_limit.per_sec <= 0.f) return true;
+    uint32_t now = now_ms();
+    if (g_conn_buckets.size() >= CONN_TABLE_MAX) {
+        for (auto it = g_conn_buckets.begin(); it != g_conn_buckets.end();) {
+            float full_in_ms = (g_conn_limit.burst - it->second.tokens) * 1e3f /
+                               g_conn_limit.per_sec;
+            if ((float)(now - it->second.last_ms) >= full_in_ms) it = g_conn_buckets.erase(it);
+            else ++it;
+        }
+    }
+    return take_token(g_conn_buckets[ip], g_conn_limit, now);
+}
+
+void ws::set_conn_rate_limit(double per_sec, double burst) {
+    g_conn_limit = { (float)per_sec, (float)std::max(1.0, burst) };
+    g_conn_buckets.clear();
+}
+
+// ─── Dispatch ─────────────────────────────────────────────────────────────────
+
+struct OpHandler {
+    const char* op;
+    bool        pre_auth;   // allowed before AUTH
+    void      (*handle)(lws*, ws::Session&, const json&);
+    RateLimit   limit;      // per session; see ws::set_rate_limit()
+};
+
+// Default limits leave room for what the client does in bursts: one
+// CHANNEL_JOIN per text channel after AUTH, 50 VOICE_DATA frames a second.
+static OpHandler OP_HANDLERS[] = {
+    { OP_AUTH,           true,  handle_auth,           {  1.f,   5.f } },
+    { OP_RESUME,         true,  handle_resume,         {  1.f,   5.f } },
+    { OP_CHANNEL_JOIN,   false, handle_channel_join,   { 50.f, 500.f } },
+    { OP_CHANNEL_LEAVE,  false, handle_channel_leave,  { 50.f, 500.f } },
+    { OP_MESSAGE_SEND,   false, handle_message_send,   {  5.f,  10.f } },
+    { OP_MESSAGE_EDIT,   false, handle_message_edit,   {  2.f,  10.f } },
+    { OP_MESSAGE_DELETE, false, handle_message_delete, {  2.f,  10.f } },
+    { OP_VOICE_JOIN,     false, handle_voice_join,     {  2.f,   5.f } },
+    { OP_VOICE_LEAVE,    false, handle_voice_leave,    {  2.f,   5.f } },
+    { OP_VOICE_DATA,     false, handle_voice_data,     { 60.f, 100.f } },
+    { OP_MEMBER_LIST_SUBSCRIBE, false, handle_member_list_subscribe, { 20.f, 40.f } },
+};
+static constexpr size_t OP_COUNT = sizeof(OP_HANDLERS) / sizeof(OP_HANDLERS[0]);
+
+// Per-op counters, parallel to OP_HANDLERS; the last slot counts invalid input.
+static metrics::Counter& op_counter(size_t i) {
+    static metrics::Counter* counters[OP_COUNT + 1] = {};
+    if (!counters[i])
+        counters[i] = &metrics::ws_op(i < OP_COUNT ? OP_HANDLERS[i].op : "invalid");
+    return *counters[i];
+}
+
+bool ws::set_rate_limit(const std::string& op, double per_sec, double burst) {
+    for (auto& h : OP_HANDLERS) {
+        if (op != h.op) continue;
+        h.limit = { (float)per_sec, (float)std::max(1.0, burst) };
+        return true;
+    }
+    return false;
+}
+
+// Charge op `i` to `session`. Over the limit the message is dropped; the
+// first drop of a run is answered with RATE_LIMITED, later ones silently so
+// a flood is not echoed back.
+static bool rate_ok(lws* wsi, ws::Session& session, size_t i) {
+    const RateLimit& lim = OP_HANDLERS[i].limit;
+    if (lim.per_sec <= 0.f) return true;
+    if (!session.rate) session.rate = std::make_unique<ws::RateBucket[]>(OP_COUNT);
+
+    ws::RateBucket& b = session.rate[i];
+    if (take_token(b, lim, now_ms())) {
+        b.limited = false;
+        return true;
+    }
+    static metrics::Counter* dropped[OP_COUNT] = {};
+    if (!dropped[i]) dropped[i] = &metrics::ws_rate_limited(OP_HANDLERS[i].op);
+    dropped[i]->inc();
+
+    if (!b.limited) {
+        b.limited = true;
+        json j;
+        j["op"]       = OP_RATE_LIMITED;
+        j["for"]      = OP_HANDLERS[i].op;
+        j["retry_ms"] = (int)((1.f - b.tokens) * 1e3f / lim.per_sec) + 1;
+        enqueue(wsi, j.dump());
+    }
+    return false;
+}
+
+static void dispatch(lws* wsi, ws::Session& session, const char* raw, size_t len) {
     json msg;
     try {
-        msg = json::parse(raw);
+        msg = json::parse(raw, raw + len);
     } catch (...) {
+        op_counter(OP_COUNT).inc();
         send_error(wsi, OP_ERROR, "malformed JSON");
         return;
     }
 
     std::string op = msg.value("op", "");
 
-    // AUTH is the only op allowed before authentication
-    if (op == OP_AUTH) { handle_auth(wsi, session, msg); return; }
+    size_t i = 0;
+    while (i < OP_COUNT && op != OP_HANDLERS[i].op) i++;
+    op_counter(i).inc();
+    if (i < OP_COUNT && !rate_ok(wsi, session, i)) return;
 
-    if (!session.authed) {
+    // AUTH / RESUME are the only ops allowed before authentication
+    if (!session.authed && (i == OP_COUNT || !OP_HANDLERS[i].pre_auth)) {
         send_error(wsi, OP_AUTH_FAIL, "not authenticated");
         return;
     }
-
-    if      (op == OP_CHANNEL_JOIN)    handle_channel_join(wsi, session, msg);
-    else if (op == OP_CHANNEL_LEAVE)   handle_channel_leave(wsi, session, msg);
-    else if (op == OP_MESSAGE_SEND)    handle_message_send(wsi, session, msg);
-    else if (op == OP_MESSAGE_EDIT)    handle_message_edit(wsi, session, msg);
-    else if (op == OP_MESSAGE_DELETE)  handle_message_delete(wsi, session, msg);
-    else if (op == OP_VOICE_JOIN)      handle_voice_join(wsi, session, msg);
-    else if (op == OP_VOICE_LEAVE)     handle_voice_leave(wsi, session, msg);
-    else if (op == OP_VOICE_DATA)      handle_voice_data(wsi, session, msg);
-    else                               send_error(wsi, OP_ERROR, "unknown op");
+    if (i == OP_COUNT) {
+        send_error(wsi, OP_ERROR, "unknown op");
+        return;
+    }
+    OP_HANDLERS[i].handle(wsi, session, msg);
 }
 
 // ─── lws callback ─────────────────────────────────────────────────────────────
@@ -262,62 +1185,90 @@ static int ws_callback(lws* wsi, lws_callback_reasons reason,
                        void* /*user*/, void* in, size_t len) {
     switch (reason) {
     // ── Connection established ──────────────────────────────────────────────
-    case LWS_CALLBACK_ESTABLISHED:
-        g_sessions[wsi] = ws::Session{};
-        fprintf(stdout, "[ws] client connected\n");
+    case LWS_CALLBACK_ESTABLISHED: {
+        // Refused before a session exists, so CLOSED has nothing to undo.
+        // Not logged: that would let a flood fill the log instead.
+        char ip[64] = "";
+        lws_get_peer_simple(wsi, ip, sizeof(ip));
+        if (!accept_connection(ip)) {
+            static metrics::Counter& refused = metrics::ws_rate_limited("connect");
+            refused.inc();
+            static const char reason[] = "rate limited";
+            lws_close_reason(wsi, LWS_CLOSE_STATUS_POLICY_VIOLATION,
+                             (unsigned char*)reason, sizeof(reason) - 1);
+            return -1;
+        }
+        add_session(wsi);
+        metrics::ws_sessions.inc();
+        if (g_auth_timeout_secs > 0)
+            lws_set_timeout(wsi, PENDING_TIMEOUT_USER_OK, g_auth_timeout_secs);
+        if (g_log_connections) fprintf(stdout, "[ws] client connected\n");
         break;
+    }
 
     // ── Connection closed ───────────────────────────────────────────────────
     case LWS_CALLBACK_CLOSED: {
-        auto it = g_sessions.find(wsi);
-        if (it != g_sessions.end()) {
-            if (it->second.authed) {
-                // Notify remaining sessions of user going offline
-                json notify;
-                notify["op"]      = OP_USER_OFFLINE;
-                notify["user_id"] = it->second.user_id;
-                std::string notify_json = notify.dump();
-                for (auto& [other_wsi, other_sess] : g_sessions) {
-                    if (other_sess.authed && other_wsi != wsi)
-                        enqueue(other_wsi, notify_json);
+        if (ws::Session* session = find_session(wsi)) {
+            size_t queued_bytes = 0;
+            for (auto& frame : session->write_queue) queued_bytes += frame.size();
+            metrics::ws_queue_frames.add(-(int64_t)session->write_queue.size());
+            metrics::ws_queue_bytes.add(-(int64_t)queued_bytes);
+            metrics::ws_sessions.dec();
+
+            if (session->authed) {
+                metrics::ws_sessions_authed.dec();
+                auto online = g_online.find(session->user_id);
+                if (online != g_online.end() && --online->second.connections == 0) {
+                    publish_presence("offline", json::array({online->first}));
+                    if (online->second.nodes == 0) {
+                        queue_presence(lws_get_context(wsi), online->first, online->second, false);
+                        g_online.erase(online);
+                    }
                 }
                 // Notify voice channels that user left
-                for (int ch_id : it->second.voice_channels) {
-                    json vleft;
-                    vleft["op"]         = OP_VOICE_LEFT;
-                    vleft["channel_id"] = ch_id;
-                    vleft["user_id"]    = it->second.user_id;
-                    ws::broadcast_to_voice(ch_id, vleft.dump(), wsi);
+                for (int ch_id : session->voice_channels) {
+                    voice_exited(ch_id, session->user_id);
+                    ws::broadcast_to_voice(ch_id, voice_left_json(ch_id, session->user_id), wsi);
                 }
             }
-            g_sessions.erase(it);
+            for (int ch_id : session->subscribed_channels) channel_unsubscribed(ch_id);
+            remove_session(wsi);
         }
-        fprintf(stdout, "[ws] client disconnected\n");
+        if (g_log_connections) fprintf(stdout, "[ws] client disconnected\n");
         break;
     }
 
     // ── Data received ───────────────────────────────────────────────────────
     case LWS_CALLBACK_RECEIVE: {
-        auto it = g_sessions.find(wsi);
-        if (it == g_sessions.end()) break;
+        ws::Session* session = find_session(wsi);
+        if (!session) break;
 
-        ws::Session& session = it->second;
-        session.recv_buf.append(static_cast<char*>(in), len);
+        // Nearly every message arrives whole: parse it in place
+        const char* data = static_cast<const char*>(in);
+        if (lws_is_first_fragment(wsi) && lws_is_final_fragment(wsi)) {
+            dispatch(wsi, *session, data, len);
+            break;
+        }
+        session->recv_buf.append(data, len);
 
         if (!lws_is_final_fragment(wsi)) break; // wait for remaining fragments
 
-        dispatch(wsi, session, session.recv_buf);
-        session.recv_buf.clear();
+        dispatch(wsi, *session, session->recv_buf.data(), session->recv_buf.size());
+        std::string().swap(session->recv_buf);
         break;
     }
 
+    // ── Cluster bus has messages (lws_cancel_service) ───────────────────────
+    case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+        cluster::drain();
+        break;
+
     // ── Ready to write ──────────────────────────────────────────────────────
     case LWS_CALLBACK_SERVER_WRITEABLE: {
-        auto it = g_sessions.find(wsi);
-        if (it == g_sessions.end()) break;
+        ws::Session* found = find_session(wsi);
+        if (!found || found->write_queue.empty()) break;
 
-        ws::Session& session = it->second;
-        if (session.write_queue.empty()) break;
+        ws::Session& session = *found;
 
         const std::string& msg = session.write_queue.front();
         size_t msg_len = msg.size();
@@ -330,9 +1281,13 @@ static int ws_callback(lws* wsi, lws_callback_reasons reason,
                                 buf.data() + LWS_PRE,
                                 msg_len,
                                 LWS_WRITE_TEXT);
-        if (written < (int)msg_len)
+        if (written < (int)msg_len) {
             fprintf(stderr, "[ws] partial write\n");
+            metrics::ws_dropped_frames.inc();
+        }
 
+        metrics::ws_queue_frames.dec();
+        metrics::ws_queue_bytes.add(-(int64_t)msg_len);
         session.write_queue.pop_front();
 
         if (!session.write_queue.empty())
@@ -349,23 +1304,31 @@ static int ws_callback(lws* wsi, lws_callback_reasons reason,
 // ─── Broadcast ────────────────────────────────────────────────────────────────
 
 void ws::broadcast_to_channel(int channel_id, const std::string& json_msg) {
-    for (auto& [wsi, session] : g_sessions) {
-        if (session.authed && session.subscribed_channels.count(channel_id)) {
-            session.write_queue.push_back(json_msg);
-            lws_callback_on_writable(wsi);
+    uint64_t recipients = 0;
+    for (auto& session : g_sessions) {
+        if (session.authed && session.subscribed_channels.contains(channel_id)) {
+            push_frame(session.wsi, session, json_msg);
+            recipients++;
         }
     }
+    metrics::ws_broadcast_fanout.observe(recipients);
 }
 
 void ws::broadcast_to_voice(int channel_id, const std::string& json_msg,
                             lws* exclude_wsi) {
-    for (auto& [wsi, session] : g_sessions) {
-        if (wsi == exclude_wsi) continue;
-        if (session.authed && session.voice_channels.count(channel_id)) {
-            session.write_queue.push_back(json_msg);
-            lws_callback_on_writable(wsi);
+    uint64_t recipients = 0;
+    for (auto& session : g_sessions) {
+        if (session.wsi == exclude_wsi) continue;
+        if (session.authed && session.voice_channels.contains(channel_id)) {
+            push_frame(session.wsi, session, json_msg);
+            recipients++;
         }
     }
+    metrics::ws_broadcast_fanout.observe(recipients);
+}
+
+bool ws::is_user_online(int user_id) {
+    return g_online.count(user_id) > 0;
 }
 
 // ─── Protocol descriptor ──────────────────────────────────────────────────────
@@ -1,30 +1,111 @@
 #pragma once
+#include "int_set.h"
+
 #include <libwebsockets.h>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <set>
-#include <deque>
-#include <map>
+#include <vector>
 
 namespace ws {
 
-// Per-connection session data (stored in a global map, keyed by lws*)
+// Window of a server's member list a session subscribed to with
+// MEMBER_LIST_SUBSCRIBE, and what it was last sent (to skip no-op updates).
+struct MemberListSub {
+    int              server_id   = 0;
+    int              start       = 0;
+    int              count       = 0;
+    std::vector<int> sent_ids;
+    int              sent_online = -1;
+    int              sent_total  = -1;
+};
+
+// Token bucket of one op of one session (or of one peer IP for new
+// connections). Refilled lazily when the next message arrives.
+struct RateBucket {
+    float    tokens  = -1.f;    // < 0: not used yet, starts full
+    uint32_t last_ms = 0;
+    bool     limited = false;   // RATE_LIMITED sent for the current run of drops
+};
+
+// Outgoing frames of one session, oldest first. A vector consumed from
+// `head` rather than a std::deque, which allocates ~600 bytes even when
+// empty: nothing is allocated until the first frame, and the storage is
+// freed again whenever the queue drains.
+struct WriteQueue {
+    std::vector<std::string> frames;
+    uint32_t                 head = 0;
+
+    bool               empty() const { return head == frames.size(); }
+    size_t             size()  const { return frames.size() - head; }
+    const std::string& front() const { return frames[head]; }
+    auto               begin() const { return frames.begin() + head; }
+    auto               end()   const { return frames.end(); }
+
+    void push_back(const std::string& frame) { frames.push_back(frame); }
+    void pop_front() {
+        if (++head == frames.size()) {
+            std::vector<std::string>().swap(frames);
+            head = 0;
+        } else if (head >= 16 && head * 2 >= frames.size()) {
+            frames.erase(frames.begin(), frames.begin() + head);   // amortised O(1)
+            head = 0;
+        } else {
+            std::string().swap(frames[head - 1]);
+        }
+    }
+};
+
+// Per-connection session data, kept in one contiguous array (see ws.cpp).
+// Laid out for the idle case, which is nearly every session: the fields
+// broadcasts test come first, id sets are inline, the username points into
+// the user directory, and buffers are allocated only while in use.
 struct Session {
-    int         user_id   = 0;
-    std::string username;
-    bool        authed    = false;
-    std::set<int>           subscribed_channels;
-    std::set<int>           voice_channels;  // voice channels this session is in
-    std::deque<std::string> write_queue;
-    std::string             recv_buf;   // accumulate WebSocket fragments
+    lws*                           wsi          = nullptr;
+    int                            user_id      = 0;
+    bool                           authed       = false;
+    // Set by AUTH/RESUME "lazy_members": no "online" list and no
+    // PRESENCE_DIFF; the client follows presence through member_list only.
+    bool                           lazy_members = false;
+    IntSet                         subscribed_channels;
+    IntSet                         voice_channels;   // voice channels this session is in
+    IntSet                         server_ids;       // scopes presence fan-out
+    const std::string*             username     = nullptr;   // db::interned_username()
+    std::unique_ptr<MemberListSub> member_list;      // null = not subscribed
+    WriteQueue                     write_queue;
+    std::string                    recv_buf;   // fragments of a split message
+    std::unique_ptr<RateBucket[]>  rate;       // per op, parallel to the dispatch table
 };
 
-// Send `json_msg` to all sessions subscribed to text `channel_id`.
+// Limit `op` to `per_sec` messages per second per session, with bursts of up
+// to `burst`; per_sec 0 = unlimited. False if `op` is not a client op.
+bool set_rate_limit(const std::string& op, double per_sec, double burst);
+
+// Limit new WebSocket connections per peer IP, likewise.
+void set_conn_rate_limit(double per_sec, double burst);
+
+// Close connections that have not authenticated `secs` after connecting
+// (0 = never).
+void set_auth_timeout(int secs);
+
+// Log every connect and disconnect to stdout (default on).
+void set_log_connections(bool on);
+
+// Cluster mode: exchange channel, voice and presence events with the other
+// nodes over the cluster bus. Call once, after cluster::start().
+void join_cluster(lws_context* ctx);
+
+// Send `json_msg` to all sessions subscribed to text `channel_id` on this node.
 void broadcast_to_channel(int channel_id, const std::string& json_msg);
 
-// Send `json_msg` to all sessions in voice `channel_id`, excluding `exclude_wsi`.
+// Send `json_msg` to all sessions in voice `channel_id` on this node,
+// excluding `exclude_wsi`.
 void broadcast_to_voice(int channel_id, const std::string& json_msg,
                         lws* exclude_wsi = nullptr);
 
+// True if the user has at least one authenticated session (on any node).
+bool is_user_online(int user_id);
+
 // lws protocol entry – must be included in the protocols[] array.
 extern lws_protocols protocol;
 
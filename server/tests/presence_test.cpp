@@ -0,0 +1,181 @@
+// norichat_presence_test – batched presence must converge for every session.
+//
+// Links the real auth/db/ws/metrics sources against the fake libwebsockets
+// below, which keeps what each connection is sent and lets the test fire the
+// presence flush timer by hand. A user goes online and offline (or offline
+// and online) inside one batch while another session authenticates in
+// between; that session must end up with the user's final state.
+
+#include "auth/auth.h"
+#include "db/db.h"
+#include "ws/ws.h"
+#include "../../shared/protocol/messages.h"
+
+#include <libwebsockets.h>
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// ─── Fake libwebsockets ───────────────────────────────────────────────────────
+
+static std::map<lws*, std::vector<std::string>> g_written;   // frames per connection
+static lws_sorted_usec_list_t*                  g_timer    = nullptr;
+static sul_cb_t                                 g_timer_cb = nullptr;
+
+int lws_write(struct lws* wsi, unsigned char* buf, size_t len,
+              enum lws_write_protocol /*protocol*/) {
+    g_written[wsi].emplace_back((const char*)buf, len);
+    return (int)len;
+}
+
+int lws_callback_on_writable(struct lws* /*wsi*/) { return 1; }
+
+int lws_is_first_fragment(struct lws* /*wsi*/) { return 1; }
+
+int lws_is_final_fragment(struct lws* /*wsi*/) { return 1; }
+
+struct lws_context* lws_get_context(const struct lws* /*wsi*/) { return nullptr; }
+
+const char* lws_get_peer_simple(struct lws* /*wsi*/, char* name, size_t namelen) {
+    snprintf(name, namelen, "127.0.0.1");
+    return name;
+}
+
+void lws_set_timeout(struct lws* /*wsi*/, enum pending_timeout /*reason*/, int /*secs*/) {}
+
+void lws_close_reason(struct lws* /*wsi*/, enum lws_close_status /*status*/,
+                      unsigned char* /*buf*/, size_t /*len*/) {}
+
+// Only the presence flush is scheduled on a null context; remember it.
+void lws_sul_schedule(struct lws_context* /*ctx*/, int /*tsi*/,
+                      lws_sorted_usec_list_t* sul, sul_cb_t cb, lws_usec_t /*us*/) {
+    g_timer    = sul;
+    g_timer_cb = cb;
+}
+
+// ─── Client model ─────────────────────────────────────────────────────────────
+
+// One fake connection and the set of users it currently believes online,
+// built the way the client does: AUTH_OK's list, then PRESENCE_DIFFs.
+struct Client {
+    char          handle = 0;   // its address is the lws*
+    std::set<int> online;
+
+    lws* wsi() { return reinterpret_cast<lws*>(&handle); }
+};
+
+static void event(lws* wsi, lws_callback_reasons reason, const std::string& data = "") {
+    ws::protocol.callback(wsi, reason, nullptr, const_cast<char*>(data.data()), data.size());
+}
+
+// Deliver queued frames and apply the presence they carry.
+static void pump(Client& c) {
+    for (int i = 0; i < 8; i++) event(c.wsi(), LWS_CALLBACK_SERVER_WRITEABLE);
+    for (auto& frame : g_written[c.wsi()]) {
+        json msg = json::parse(frame, nullptr, false);
+        if (!msg.is_object()) continue;
+        std::string op = msg.value("op", "");
+        if (op == OP_AUTH_OK) {
+            for (auto& u : msg["online"]) c.online.insert(u["user_id"].get<int>());
+        } else if (op == OP_PRESENCE_DIFF) {
+            for (auto& u : msg["online"])  c.online.insert(u["user_id"].get<int>());
+            for (auto& id : msg["offline"]) c.online.erase(id.get<int>());
+        }
+    }
+    g_written[c.wsi()].clear();
+}
+
+static void open_session(Client& c, const User& user) {
+    event(c.wsi(), LWS_CALLBACK_ESTABLISHED);
+    json auth;
+    auth["op"]    = OP_AUTH;
+    auth["token"] = auth::generate_jwt(user.id, user.username);
+    event(c.wsi(), LWS_CALLBACK_RECEIVE, auth.dump());
+}
+
+static void close_session(Client& c) {
+    event(c.wsi(), LWS_CALLBACK_CLOSED);
+    g_written.erase(c.wsi());
+    c.online.clear();
+}
+
+static void flush() {
+    if (g_timer_cb) {
+        sul_cb_t cb = g_timer_cb;
+        g_timer_cb  = nullptr;
+        cb(g_timer);
+    }
+}
+
+static int g_failures = 0;
+
+static void expect(bool ok, const char* what) {
+    fprintf(ok ? stdout : stderr, "[%s] %s\n", ok ? "pass" : "FAIL", what);
+    if (!ok) g_failures++;
+}
+
+// ─── Entry point ──────────────────────────────────────────────────────────────
+
+int main() {
+    std::string path = "/tmp/norichat_presence_test_" + std::to_string(getpid()) + ".db";
+    auto remove_db = [&] {
+        for (const char* suffix : { "", "-wal", "-shm" }) std::remove((path + suffix).c_str());
+    };
+    remove_db();
+    if (!db::init(path.c_str())) {
+        fprintf(stderr, "[presence_test] cannot open %s\n", path.c_str());
+        return 1;
+    }
+    ws::set_conn_rate_limit(0, 0);
+
+    std::vector<User> users;
+    for (const char* name : { "alice", "bob", "carol" }) {
+        auto user = db::create_user(name, "x");
+        db::add_membership(user->id, 1);
+        users.push_back(*user);
+    }
+    const int alice = users[0].id;
+
+    Client watcher, a1, a2, late1, late2;
+    open_session(watcher, users[1]);
+    flush();
+    pump(watcher);
+
+    // Online, then offline in the same batch; `late1` authenticates between
+    open_session(a1, users[0]);
+    open_session(late1, users[2]);
+    close_session(a1);
+    flush();
+    pump(watcher);
+    pump(late1);
+    expect(!late1.online.count(alice), "session authed mid-batch sees online->offline");
+    expect(!watcher.online.count(alice), "existing session sees online->offline");
+
+    // Offline, then online in the same batch; `late2` authenticates between
+    open_session(a1, users[0]);
+    flush();
+    pump(watcher);
+    pump(late1);
+    close_session(a1);
+    open_session(late2, users[2]);
+    open_session(a2, users[0]);
+    flush();
+    pump(watcher);
+    pump(late1);
+    pump(late2);
+    expect(late2.online.count(alice) == 1, "session authed mid-batch sees offline->online");
+    expect(late1.online.count(alice) == 1, "existing session sees offline->online");
+    expect(watcher.online.count(alice) == 1, "first session sees offline->online");
+
+    db::close();
+    remove_db();
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+// norichat_broker – pub/sub hub for a NoriChat cluster.
+//
+// Every norichat_server started with --cluster connects here, subscribes to
+// the topics it has local interest in (a channel with a subscribed session,
+// a voice channel with a participant, presence) and publishes its events.
+// The broker forwards each publish to the other connections subscribed to
+// its topic and nothing else, so channel traffic only reaches nodes with a
+// local subscriber. Frames are described in src/cluster/wire.h.
+//
+// Single-threaded poll() loop; no persistence: a message for a node that is
+// not connected is gone, and nodes resync when they reconnect.
+//
+//   norichat_broker --listen tcp:0.0.0.0:7070
+//   norichat_broker --listen unix:/run/norichat/broker.sock
+
+#include "cluster/wire.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wire = cluster::wire;
+
+// A node whose unsent output grows past this is too slow to keep up; it is
+// disconnected (and resyncs on reconnect) rather than growing the broker.
+static const size_t MAX_PENDING = 64u << 20;
+
+// Sent bytes at the front of Conn::out are dropped once there are this many
+// and they are at least half the buffer, so a node that never quite catches
+// up does not keep everything it was ever sent.
+static const size_t COMPACT_AT = 1u << 20;
+
+struct Conn {
+    int                   fd = -1;
+    std::string           name;      // from the hello frame
+    std::string           in;
+    std::string           out;
+    size_t                out_pos = 0;
+    std::set<std::string> topics;
+    bool                  closing = false;
+};
+
+static volatile sig_atomic_t g_interrupted = 0;
+
+static void sigint_handler(int) { g_interrupted = 1; }
+
+static std::map<int, std::unique_ptr<Conn>>                g_conns;    // by fd
+static std::unordered_map<std::string, std::set<Conn*>>    g_topics;   // topic → subscribers
+static std::unordered_map<std::string, Conn*>              g_names;    // node name → connection
+
+static void send_publish(Conn* to, const std::string& topic, const std::string& payload) {
+    if (to->closing) return;
+    wire::append_frame(to->out, 'P', topic, payload);
+    if (to->out.size() - to->out_pos > MAX_PENDING) {
+        fprintf(stderr, "[broker] %s is not reading, disconnecting it\n", to->name.c_str());
+        to->closing = true;
+    }
+}
+
+static void publish(Conn* from, const std::string& topic, const std::string& payload) {
+    auto it = g_topics.find(topic);
+    if (it == g_topics.end()) return;
+    for (Conn* c : it->second)
+        if (c != from) send_publish(c, topic, payload);
+}
+
+// Drop `c` from the topic table; announce its node as down unless a newer
+// connection took over the name.
+static void forget(Conn* c) {
+    for (auto& topic : c->topics) {
+        auto it = g_topics.find(topic);
+        if (it == g_topics.end()) continue;
+        it->second.erase(c);
+        if (it->second.empty()) g_topics.erase(it);
+    }
+    c->topics.clear();
+    auto named = g_names.find(c->name);
+    if (!c->name.empty() && named != g_names.end() && named->second == c) {
+        g_names.erase(named);
+        fprintf(stdout, "[broker] node %s left\n", c->name.c_str());
+        publish(c, wire::DOWN_TOPIC, c->name);
+    }
+}
+
+static void handle_frame(Conn* c, char type, const std::string& topic,
+                         const std::string& payload) {
+    switch (type) {
+    case 'H': {
+        // A node that reconnects before its old connection timed out: the
+        // old one goes first, so its "down" precedes the new one's resync
+        auto old = g_names.find(topic);
+        if (old != g_names.end() && old->second != c) {
+            old->second->closing = true;
+            forget(old->second);
+        }
+        c->name = topic;
+        g_names[topic] = c;
+        fprintf(stdout, "[broker] node %s joined\n", c->name.c_str());
+        break;
+    }
+    case 'S':
+        if (c->topics.insert(topic).second) g_topics[topic].insert(c);
+        break;
+    case 'U':
+        if (c->topics.erase(topic)) {
+            auto it = g_topics.find(topic);
+            if (it != g_topics.end()) {
+                it->second.erase(c);
+                if (it->second.empty()) g_topics.erase(it);
+            }
+        }
+        break;
+    case 'P':
+        publish(c, topic, payload);
+        break;
+    default:
+        c->closing = true;
+        break;
+    }
+}
+
+static void read_from(Conn* c) {
+    char buf[65536];
+    ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        c->closing = true;
+        return;
+    }
+    if (n < 0) return;
+    c->in.append(buf, (size_t)n);
+
+    size_t      pos = 0;
+    char        type;
+    std::string topic, payload;
+    wire::Parse rc;
+    while (!c->closing &&
+           (rc = wire::next_frame(c->in, pos, type, topic, payload)) == wire::Parse::Frame)
+        handle_frame(c, type, topic, payload);
+    if (rc == wire::Parse::Bad) {
+        fprintf(stderr, "[broker] malformed frame from %s\n",
+                c->name.empty() ? "unnamed node" : c->name.c_str());
+        c->closing = true;
+    }
+    c->in.erase(0, pos);
+}
+
+static void write_to(Conn* c) {
+    ssize_t n = send(c->fd, c->out.data() + c->out_pos, c->out.size() - c->out_pos,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EINTR) c->closing = true;
+        return;
+    }
+    c->out_pos += (size_t)n;
+    if (c->out_pos == c->out.size()) {
+        c->out.clear();
+        c->out_pos = 0;
+    } else if (c->out_pos >= COMPACT_AT && c->out_pos >= c->out.size() / 2) {
+        c->out.erase(0, c->out_pos);
+        c->out_pos = 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* listen_addr = "tcp:127.0.0.1:7070";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            listen_addr = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--listen tcp:HOST:PORT | unix:PATH]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int listen_fd = wire::listen_on(listen_addr);
+    if (listen_fd < 0) return 1;
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+    signal(SIGINT,  sigint_handler);
+    signal(SIGTERM, sigint_handler);
+    fprintf(stdout, "[broker] listening on %s\n", listen_addr);
+
+    std::vector<pollfd> fds;
+    std::vector<Conn*>  polled;
+    while (!g_interrupted) {
+        fds.assign(1, pollfd{ listen_fd, POLLIN, 0 });
+        polled.assign(1, nullptr);
+        for (auto& [fd, c] : g_conns) {
+            short events = POLLIN;
+            if (c->out_pos < c->out.size()) events |= POLLOUT;
+            fds.push_back({ fd, events, 0 });
+            polled.push_back(c.get());
+        }
+        if (poll(fds.data(), fds.size(), 1000) < 0) {
+            if (errno == EINTR) continue;
+            perror("[broker] poll");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                wire::set_nodelay(fd);
+                auto c = std::make_unique<Conn>();
+                c->fd  = fd;
+                g_conns[fd] = std::move(c);
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            Conn* c = polled[i];
+            if (c->closing) continue;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) read_from(c);
+            if (!c->closing && (fds[i].revents & POLLOUT)) write_to(c);
+        }
+
+        // Close in a second pass: a read above may have queued output for,
+        // or marked closing, any connection
+        for (auto it = g_conns.begin(); it != g_conns.end();) {
+            Conn* c = it->second.get();
+            if (!c->closing) { ++it; continue; }
+            forget(c);
+            close(c->fd);
+            it = g_conns.erase(it);
+        }
+    }
+
+    fprintf(stdout, "\n[broker] shutting down\n");
+    for (auto& [fd, c] : g_conns) close(fd);
+    close(listen_fd);
+    return 0;
+}
@@ -0,0 +1,456 @@
+// norichat_datagen – fill a database with a large synthetic dataset and time
+// the history/member/search queries against it.
+//
+// The schema comes from db::init(); rows are then bulk-inserted through a
+// separate SQLite connection in batched transactions. Channel traffic and
+// user activity follow a Zipf distribution, so a few channels hold most of
+// the history, as in production.
+//
+//   norichat_datagen --db big.db --users 20000 --messages 5000000
+//   norichat_datagen --db big.db --bench-only
+//   norichat_datagen --db big.db --reset --messages 100000
+
+#include "auth/auth.h"
+#include "db/db.h"
+#include "../../shared/protocol/messages.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+// ─── Config ───────────────────────────────────────────────────────────────────
+
+struct Config {
+    const char* db_path             = nullptr;
+    int         users               = 1000;
+    int         servers             = 10;
+    int         channels_per_server = 8;
+    int         servers_per_user    = 3;     // in addition to the default server
+    long long   messages            = 1000000;
+    double      zipf_s              = 1.1;   // skew of channel and author choice
+    int         batch               = 10000; // rows per transaction
+    unsigned    seed                = 42;
+    std::string password            = "password";
+    bool        bench_only          = false;
+    bool        reset               = false;   // delete the database first
+    int         iterations          = 200;   // per benchmarked query
+};
+
+static Config g_cfg;
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s --db PATH [options]\n"
+        "  --users N              users to create (default 1000)\n"
+        "  --servers N            servers besides the default one (default 10)\n"
+        "  --channels N           channels per server, ~1 in 5 voice (default 8)\n"
+        "  --servers-per-user N   extra server memberships per user (default 3)\n"
+        "  --messages N           messages to insert (default 1000000)\n"
+        "  --zipf S               Zipf exponent for channel/author skew (default 1.1)\n"
+        "  --batch N              rows per transaction (default 10000)\n"
+        "  --seed N               RNG seed (default 42)\n"
+        "  --password P           password of every generated user (default password)\n"
+        "  --reset                delete PATH first; without it, generating into a\n"
+        "                         database that already has generated data fails\n"
+        "  --bench-only           skip generation, only run the query benchmark\n"
+        "  --iterations N         runs per benchmarked query (default 200)\n",
+        argv0);
+}
+
+static bool parse_args(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        auto arg = [&](const char* name) {
+            return strcmp(argv[i], name) == 0 && i + 1 < argc;
+        };
+        if      (arg("--db"))               g_cfg.db_path             = argv[++i];
+        else if (arg("--users"))            g_cfg.users               = atoi(argv[++i]);
+        else if (arg("--servers"))          g_cfg.servers             = atoi(argv[++i]);
+        else if (arg("--channels"))         g_cfg.channels_per_server = atoi(argv[++i]);
+        else if (arg("--servers-per-user")) g_cfg.servers_per_user    = atoi(argv[++i]);
+        else if (arg("--messages"))         g_cfg.messages            = atoll(argv[++i]);
+        else if (arg("--zipf"))             g_cfg.zipf_s              = atof(argv[++i]);
+        else if (arg("--batch"))            g_cfg.batch               = atoi(argv[++i]);
+        else if (arg("--seed"))             g_cfg.seed                = (unsigned)atoi(argv[++i]);
+        else if (arg("--password"))         g_cfg.password            = argv[++i];
+        else if (arg("--iterations"))       g_cfg.iterations          = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench-only") == 0) g_cfg.bench_only = true;
+        else if (strcmp(argv[i], "--reset") == 0)      g_cfg.reset      = true;
+        else return false;
+    }
+    return g_cfg.db_path && g_cfg.users > 0 && g_cfg.servers >= 0 &&
+           g_cfg.channels_per_server > 0 && g_cfg.messages >= 0 &&
+           g_cfg.batch > 0 && g_cfg.iterations > 0;
+}
+
+// ─── Helpers ──────────────────────────────────────────────────────────────────
+
+static double now_sec() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool exec(sqlite3* db, const char* sql) {
+    char* errmsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errmsg) != SQLITE_OK) {
+        fprintf(stderr, "[datagen] %s: %s\n", sql, errmsg ? errmsg : "?");
+        sqlite3_free(errmsg);
+        return false;
+    }
+    return true;
+}
+
+static sqlite3_stmt* prepare(sqlite3* db, const char* sql) {
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "[datagen] prepare: %s  sql=%s\n", sqlite3_errmsg(db), sql);
+        return nullptr;
+    }
+    return st;
+}
+
+// Commits every `batch` rows; call row() after each insert.
+class Batcher {
+public:
+    Batcher(sqlite3* db, int batch) : db_(db), batch_(batch) { exec(db_, "BEGIN"); }
+    ~Batcher() { exec(db_, "COMMIT"); }
+    void row() {
+        if (++rows_ % batch_ == 0) { exec(db_, "COMMIT"); exec(db_, "BEGIN"); }
+    }
+
+private:
+    sqlite3*  db_;
+    int       batch_;
+    long long rows_ = 0;
+};
+
+static int64_t insert_row(sqlite3* db, sqlite3_stmt* st) {
+    if (sqlite3_step(st) != SQLITE_DONE) {
+        fprintf(stderr, "[datagen] insert: %s\n", sqlite3_errmsg(db));
+        std::exit(1);
+    }
+    sqlite3_reset(st);
+    return sqlite3_last_insert_rowid(db);
+}
+
+// Samples ranks 0..n-1 with P(k) ∝ 1/(k+1)^s.
+class Zipf {
+public:
+    Zipf(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t k = 0; k < n; k++) cdf_[k] = (sum += 1.0 / std::pow((double)k + 1.0, s));
+        for (double& c : cdf_) c /= sum;
+    }
+    size_t operator()(std::mt19937& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        size_t k = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return std::min(k, cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+static const char* WORDS[] = {
+    "the", "build", "deploy", "server", "latency", "lunch", "meeting", "bug",
+    "release", "review", "merge", "coffee", "weekend", "voice", "channel",
+    "ping", "thanks", "tomorrow", "today", "fixed", "broken", "cache", "index",
+    "query", "works", "again", "please", "check", "logs", "ship", "it", "lol",
+};
+static constexpr size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+static std::string random_text(std::mt19937& rng) {
+    int words = std::uniform_int_distribution<int>(3, 40)(rng);
+    std::string out;
+    for (int i = 0; i < words; i++) {
+        if (i) out += ' ';
+        out += WORDS[rng() % WORD_COUNT];
+    }
+    return out;
+}
+
+// ─── Generation ───────────────────────────────────────────────────────────────
+
+// True if a previous run already generated users into `db`.
+static bool has_generated_data(sqlite3* db) {
+    sqlite3_stmt* st = prepare(db, "SELECT 1 FROM users WHERE username='user_0'");
+    if (!st) return false;
+    bool found = sqlite3_step(st) == SQLITE_ROW;
+    sqlite3_finalize(st);
+    return found;
+}
+
+static bool generate() {
+    if (g_cfg.reset) {
+        std::string path = g_cfg.db_path;
+        for (const char* suffix : { "", "-wal", "-shm" })
+            std::remove((path + suffix).c_str());
+        fprintf(stdout, "[datagen] reset %s\n", g_cfg.db_path);
+    }
+
+    // Schema + default server/channel, exactly as the server creates them.
+    if (!db::init(g_cfg.db_path)) return false;
+    db::close();
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(g_cfg.db_path, &db) != SQLITE_OK) {
+        fprintf(stderr, "[datagen] cannot open %s\n", g_cfg.db_path);
+        return false;
+    }
+    // The generated names are fixed, so a second run would fail halfway on
+    // the UNIQUE constraints; refuse up front instead.
+    if (has_generated_data(db)) {
+        fprintf(stderr, "[datagen] %s already holds generated data; "
+                        "use --reset to regenerate or --bench-only to time it\n",
+                g_cfg.db_path);
+        sqlite3_close(db);
+        return false;
+    }
+    exec(db, "PRAGMA synchronous=OFF");
+    exec(db, "PRAGMA foreign_keys=OFF");
+
+    std::mt19937 rng(g_cfg.seed);
+    const int64_t now = (int64_t)time(nullptr);
+    double t0 = now_sec();
+
+    // ── Users ─────────────────────────────────────────────────────────────────
+    std::vector<int> user_ids;
+    {
+        std::string hash = auth::hash_password(g_cfg.password);   // shared by all users
+        sqlite3_stmt* st = prepare(db,
+            "INSERT INTO users(username,password_hash,created_at) VALUES(?,?,?)");
+        if (!st) return false;
+        Batcher tx(db, g_cfg.batch);
+        for (int i = 0; i < g_cfg.users; i++) {
+            std::string name = "user_" + std::to_string(i);
+            sqlite3_bind_text(st, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(st, 2, hash.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(st, 3, now - 365 * 86400);
+            user_ids.push_back((int)insert_row(db, st));
+            tx.row();
+        }
+        sqlite3_finalize(st);
+    }
+
+    // ── Servers and channels ──────────────────────────────────────────────────
+    std::vector<int> server_ids = { 1 };
+    std::vector<int> text_channels;               // channel id
+    std::vector<int> text_channel_server;         // parallel: owning server index
+    {
+        sqlite3_stmt* sv = prepare(db, "INSERT INTO servers(name,owner_id) VALUES(?,?)");
+        sqlite3_stmt* ch = prepare(db,
+            "INSERT INTO channels(server_id,name,type) VALUES(?,?,?)");
+        if (!sv || !ch) return false;
+        Batcher tx(db, g_cfg.batch);
+        for (int i = 0; i < g_cfg.servers; i++) {
+            std::string name = "server_" + std::to_string(i);
+            sqlite3_bind_text(sv, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(sv, 2, user_ids[rng() % user_ids.size()]);
+            server_ids.push_back((int)insert_row(db, sv));
+            tx.row();
+        }
+        text_channels.push_back(1);               // seeded "general"
+        text_channel_server.push_back(0);
+        for (size_t s = 0; s < server_ids.size(); s++) {
+            for (int c = 0; c < g_cfg.channels_per_server; c++) {
+                bool voice = (c % 5 == 4);
+                std::string name = (voice ? "voice-" : "chat-") + std::to_string(c);
+                sqlite3_bind_int(ch, 1, server_ids[s]);
+                sqlite3_bind_text(ch, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(ch, 3, voice ? "voice" : "text", -1, SQLITE_STATIC);
+                int id = (int)insert_row(db, ch);
+                tx.row();
+                if (!voice) {
+                    text_channels.push_back(id);
+                    text_channel_server.push_back((int)s);
+                }
+            }
+        }
+        sqlite3_finalize(sv);
+        sqlite3_finalize(ch);
+    }
+
+    // ── Memberships ───────────────────────────────────────────────────────────
+    // Everyone is in the default server (as registration does) plus a few
+    // Zipf-chosen ones, so some servers are huge and most are small.
+    std::vector<std::vector<int>> server_members(server_ids.size());
+    {
+        sqlite3_stmt* st = prepare(db,
+            "INSERT OR IGNORE INTO memberships(user_id,server_id) VALUES(?,?)");
+        if (!st) return false;
+        Zipf pick_server(server_ids.size(), g_cfg.zipf_s);
+        Batcher tx(db, g_cfg.batch);
+        for (int uid : user_ids) {
+            std::vector<size_t> mine = { 0 };
+            for (int k = 0; k < g_cfg.servers_per_user && server_ids.size() > 1; k++) {
+                size_t s = pick_server(rng);
+                if (std::find(mine.begin(), mine.end(), s) == mine.end()) mine.push_back(s);
+            }
+            for (size_t s : mine) {
+                sqlite3_bind_int(st, 1, uid);
+                sqlite3_bind_int(st, 2, server_ids[s]);
+                insert_row(db, st);
+                tx.row();
+                server_members[s].push_back(uid);
+            }
+        }
+        sqlite3_finalize(st);
+    }
+
+    // ── Messages ──────────────────────────────────────────────────────────────
+    // Channel popularity is Zipf over a shuffled channel order; authors are
+    // Zipf over the channel's server members. Timestamps rise with id over
+    // the past year.
+    {
+        std::vector<size_t> channel_rank(text_channels.size());
+        for (size_t i = 0; i < channel_rank.size(); i++) channel_rank[i] = i;
+        std::shuffle(channel_rank.begin(), channel_rank.end(), rng);
+        Zipf pick_channel(text_channels.size(), g_cfg.zipf_s);
+
+        std::vector<Zipf> pick_author;
+        for (auto& members : server_members)
+            pick_author.emplace_back(std::max<size_t>(members.size(), 1), g_cfg.zipf_s);
+
+        sqlite3_stmt* st = prepare(db,
+            "INSERT INTO messages(channel_id,author_id,content,ts) VALUES(?,?,?,?)");
+        if (!st) return false;
+        Batcher tx(db, g_cfg.batch);
+        const int64_t span = 365 * 86400;
+        for (long long i = 0; i < g_cfg.messages; i++) {
+            size_t c      = channel_rank[pick_channel(rng)];
+            size_t s      = (size_t)text_channel_server[c];
+            auto& members = server_members[s];
+            if (members.empty()) continue;
+            int author    = members[pick_author[s](rng)];
+            std::string content = random_text(rng);
+
+            sqlite3_bind_int(st, 1, text_channels[c]);
+            sqlite3_bind_int(st, 2, author);
+            sqlite3_bind_text(st, 3, content.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(st, 4, now - span + (span * i) / std::max(g_cfg.messages, 1LL));
+            insert_row(db, st);
+            tx.row();
+
+            if ((i + 1) % 1000000 == 0)
+                fprintf(stdout, "[datagen] %lld messages\n", i + 1);
+        }
+        sqlite3_finalize(st);
+    }
+
+    exec(db, "PRAGMA wal_checkpoint(TRUNCATE)");
+    sqlite3_close(db);
+    fprintf(stdout, "[datagen] %d users, %zu servers, %zu text channels, %lld messages in %.1f s\n",
+            g_cfg.users, server_ids.size(), text_channels.size(), g_cfg.messages,
+            now_sec() - t0);
+    return true;
+}
+
+// ─── Benchmark ────────────────────────────────────────────────────────────────
+
+struct Timing {
+    std::vector<double> ms;
+    void report(const char* what) {
+        std::sort(ms.begin(), ms.end());
+        double sum = 0.0;
+        for (double v : ms) sum += v;
+        fprintf(stdout, "  %-44s avg %8.3f  p50 %8.3f  p99 %8.3f  ms\n", what,
+                sum / (double)ms.size(), ms[ms.size() / 2],
+                ms[std::min(ms.size() - 1, (size_t)((double)ms.size() * 0.99))]);
+    }
+};
+
+template <typename F>
+static void time_query(const char* what, F&& fn) {
+    Timing t;
+    for (int i = 0; i < g_cfg.iterations; i++) {
+        double start = now_sec();
+        fn();
+        t.ms.push_back((now_sec() - start) * 1000.0);
+    }
+    t.report(what);
+}
+
+// Returns (id, rows) pairs for a query of the form "SELECT id, COUNT(*) ...".
+static std::vector<std::pair<int, long long>> counts(sqlite3* db, const char* sql) {
+    std::vector<std::pair<int, long long>> out;
+    sqlite3_stmt* st = prepare(db, sql);
+    if (!st) return out;
+    while (sqlite3_step(st) == SQLITE_ROW)
+        out.emplace_back(sqlite3_column_int(st, 0), sqlite3_column_int64(st, 1));
+    sqlite3_finalize(st);
+    return out;
+}
+
+static bool bench() {
+    sqlite3* raw = nullptr;
+    if (sqlite3_open_v2(g_cfg.db_path, &raw, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "[datagen] cannot open %s\n", g_cfg.db_path);
+        return false;
+    }
+    auto channels = counts(raw,
+        "SELECT channel_id, COUNT(*) c FROM messages GROUP BY channel_id ORDER BY c DESC");
+    auto servers  = counts(raw,
+        "SELECT server_id, COUNT(*) c FROM memberships GROUP BY server_id ORDER BY c DESC");
+    if (channels.empty() || servers.empty()) {
+        fprintf(stderr, "[datagen] database has no messages or memberships\n");
+        sqlite3_close(raw);
+        return false;
+    }
+
+    double t0 = now_sec();
+    if (!db::init(g_cfg.db_path)) { sqlite3_close(raw); return false; }
+    fprintf(stdout, "[datagen] db::init (schema + in-memory indexes): %.1f ms\n",
+            (now_sec() - t0) * 1000.0);
+
+    char label[96];
+    auto hot  = channels.front();
+    auto med  = channels[channels.size() / 2];
+    auto cold = channels.back();
+    for (auto ch : { hot, med, cold }) {
+        snprintf(label, sizeof(label), "get_messages(ch %d, %lld rows, limit %d)",
+                 ch.first, ch.second, DEFAULT_MSG_LIMIT);
+        time_query(label, [&] { db::get_messages(ch.first, DEFAULT_MSG_LIMIT); });
+    }
+    for (auto sv : { servers.front(), servers.back() }) {
+        snprintf(label, sizeof(label), "get_server_members(srv %d, %lld members)",
+                 sv.first, sv.second);
+        time_query(label, [&] { db::get_server_members(sv.first); });
+    }
+
+    // No search API exists yet; this is the query one would naively write.
+    sqlite3_stmt* search = prepare(raw,
+        "SELECT id,author_id,content,ts FROM messages "
+        "WHERE channel_id=? AND content LIKE ? ORDER BY id DESC LIMIT 50");
+    if (search) {
+        for (auto ch : { hot, cold }) {
+            snprintf(label, sizeof(label), "LIKE '%%release%%' (ch %d)", ch.first);
+            time_query(label, [&] {
+                sqlite3_bind_int(search, 1, ch.first);
+                sqlite3_bind_text(search, 2, "%release%", -1, SQLITE_STATIC);
+                while (sqlite3_step(search) == SQLITE_ROW) {}
+                sqlite3_reset(search);
+            });
+        }
+        sqlite3_finalize(search);
+    }
+
+    db::close();
+    sqlite3_close(raw);
+    return true;
+}
+
+// ─── Entry point ──────────────────────────────────────────────────────────────
+
+int main(int argc, char* argv[]) {
+    if (!parse_args(argc, argv)) { usage(argv[0]); return 2; }
+    if (!g_cfg.bench_only && !generate()) return 1;
+    return bench() ? 0 : 1;
+}
@@ -3,6 +3,7 @@
 // ─── WebSocket opcodes ────────────────────────────────────────────────────────
 // Client → Server
 #define OP_AUTH             "AUTH"
+#define OP_RESUME           "RESUME"        // {token, epoch, last_seq, channels:[id]}
 #define OP_CHANNEL_JOIN     "CHANNEL_JOIN"
 #define OP_CHANNEL_LEAVE    "CHANNEL_LEAVE"
 #define OP_MESSAGE_SEND     "MESSAGE_SEND"
@@ -12,20 +13,25 @@
 #define OP_VOICE_JOIN       "VOICE_JOIN"
 #define OP_VOICE_LEAVE      "VOICE_LEAVE"
 #define OP_VOICE_DATA       "VOICE_DATA"    // {channel_id, data:<base64 PCM>}
+// Member list – Client → Server
+#define OP_MEMBER_LIST_SUBSCRIBE "MEMBER_LIST_SUBSCRIBE" // {server_id, start, count}; count 0 = stop
 
 // Server → Client
 #define OP_AUTH_OK          "AUTH_OK"
 #define OP_AUTH_FAIL        "AUTH_FAIL"
+#define OP_RESUMED          "RESUMED"        // AUTH_OK fields + {reload:[channel_id]}
 #define OP_MESSAGE_NEW      "MESSAGE_NEW"
-#define OP_USER_ONLINE      "USER_ONLINE"
-#define OP_USER_OFFLINE     "USER_OFFLINE"
+#define OP_PRESENCE_DIFF    "PRESENCE_DIFF"  // {online:[{user_id,username}], offline:[user_id]}
 #define OP_MESSAGE_EDITED   "MESSAGE_EDITED"
 #define OP_MESSAGE_DELETED  "MESSAGE_DELETED"
 #define OP_ERROR            "ERROR"
+#define OP_RATE_LIMITED     "RATE_LIMITED"   // {for:<op>, retry_ms}; the message was dropped
 // Voice – Server → Client
 #define OP_VOICE_JOIN_OK    "VOICE_JOIN_OK"  // {channel_id, participants:[{user_id,username}]}
 #define OP_VOICE_JOINED     "VOICE_JOINED"   // {channel_id, user_id, username}
 #define OP_VOICE_LEFT       "VOICE_LEFT"     // {channel_id, user_id}
+// Member list – Server → Client
+#define OP_MEMBER_LIST      "MEMBER_LIST"    // {server_id, start, online_count, total, members:[{user_id,username,online}]}
 
 // ─── HTTP paths ───────────────────────────────────────────────────────────────
 #define API_REGISTER      "/api/register"
@@ -34,12 +40,17 @@
 #define API_CHANNELS      "/api/channels"
 #define API_MESSAGES      "/api/messages"
 #define API_MEMBERS       "/api/members"
+#define API_BOOTSTRAP     "/api/bootstrap"
+#define API_METRICS       "/metrics"
 
 // ─── Limits ───────────────────────────────────────────────────────────────────
 #define MAX_MSG_LEN       4000
 #define DEFAULT_MSG_LIMIT 50
 #define WS_RX_BUFFER      65536
 #define HTTP_BODY_MAX     8192
+#define PRESENCE_FLUSH_MS 250   // presence changes are batched into one diff per interval
+#define REPLAY_RING_SIZE  256   // channel events kept per channel for RESUME
+#define MEMBER_RANGE_MAX  200   // rows per MEMBER_LIST_SUBSCRIBE window
 
 // ─── Default data ─────────────────────────────────────────────────────────────
 #define DEFAULT_SERVER_NAME "NoriChat HQ"